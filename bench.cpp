@@ -0,0 +1,824 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+/* headless benchmark of the install checks, deletion and archive
+ * extraction on synthetic game data trees inside a temporary $HOME;
+ * results are printed as one JSON object per line
+ *
+ * usage: launcher-bench [--files=N,N,...] [--depth=N] [--size=BYTES] [--runs=N]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <math.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "download.hpp"
+#include "hash.hpp"
+#include "install_index.hpp"
+#include "manifest.hpp"
+#include "mirror.hpp"
+#include "pack.hpp"
+#include "rmtree.hpp"
+#include "untar.hpp"
+
+/* same as in launcher.cpp */
+static const char *games[3] = {
+    "data-marathon-master",
+    "data-marathon-2-master",
+    "data-marathon-infinity-master"
+};
+
+/* files per leaf directory */
+#define FILES_PER_DIR 32
+
+struct options
+{
+    std::vector<int> files = { 100, 1000, 10000 };
+    int depth = 3;
+    int size = 4096;
+    int runs = 5;
+};
+
+struct file_entry
+{
+    std::string path;  /* relative to the game directory; empty name for directories */
+    bool dir;
+};
+
+
+static double now_ms()
+{
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+/* nearest-rank percentile */
+static double percentile(std::vector<double> v, double p)
+{
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    size_t i = static_cast<size_t>(ceil(p * v.size()));
+    return v[(i > 0) ? i - 1 : 0];
+}
+
+static void report(const char *name, const options &opt, int files, const std::vector<double> &ms,
+                   double items, double bytes)
+{
+    const double p50 = percentile(ms, 0.50);
+
+    printf("{\"bench\":\"%s\",\"files\":%d,\"depth\":%d,\"size\":%d,\"runs\":%zu,"
+        "\"p50_ms\":%.4f,\"p99_ms\":%.4f,\"min_ms\":%.4f",
+        name, files, opt.depth, opt.size, ms.size(),
+        p50, percentile(ms, 0.99), *std::min_element(ms.begin(), ms.end()));
+
+    if (items > 0 && p50 > 0) {
+        printf(",\"items_per_s\":%.1f", items / (p50 / 1000.0));
+    }
+
+    if (bytes > 0 && p50 > 0) {
+        printf(",\"mib_per_s\":%.2f", bytes / (1024.0*1024.0) / (p50 / 1000.0));
+    }
+
+    printf("}\n");
+    fflush(stdout);
+}
+
+static double run(const std::function<void ()> &fn)
+{
+    const double t = now_ms();
+    fn();
+    return now_ms() - t;
+}
+
+static void check(bool ok, const char *name, const std::string &msg)
+{
+    if (!ok) {
+        fprintf(stderr, "%s: %s\n", name, msg.c_str());
+        exit(1);
+    }
+}
+
+
+/* Stand-in for a download server on 127.0.0.1: every path is answered
+ * with <body> after <delay> seconds, sent at <rate> bytes per second
+ * (0 = unlimited). Ranges and If-None-Match are supported; a <status>
+ * other than 200 is sent without a body. */
+class local_server
+{
+private:
+
+    std::string m_body;
+    double m_delay;
+    double m_rate;
+    int m_status;
+    int m_fd = -1;
+    int m_port = 0;
+    std::atomic<bool> m_stop {false};
+    std::thread m_thread;
+    std::vector<std::thread> m_conns;
+    std::mutex m_mutex;
+
+    void listen_loop();
+    void serve(int fd);
+
+public:
+
+    std::atomic<int> requests {0};
+
+    /* answer Range requests with a different part of the body */
+    std::atomic<bool> wrong_range {false};
+
+    local_server(const std::string &body, double delay = 0, double rate = 0, int status = 200);
+    ~local_server();
+
+    std::string url(const std::string &path) const {
+        return "http://127.0.0.1:" + std::to_string(m_port) + path;
+    }
+};
+
+local_server::local_server(const std::string &body, double delay, double rate, int status)
+: m_body(body), m_delay(delay), m_rate(rate), m_status(status)
+{
+    struct sockaddr_in sa;
+    socklen_t len = sizeof(sa);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    m_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    check(m_fd != -1 && bind(m_fd, reinterpret_cast<struct sockaddr *>(&sa), sizeof(sa)) == 0 &&
+          listen(m_fd, 16) == 0 && getsockname(m_fd, reinterpret_cast<struct sockaddr *>(&sa), &len) == 0,
+          "local_server", strerror(errno));
+
+    m_port = ntohs(sa.sin_port);
+    m_thread = std::thread(&local_server::listen_loop, this);
+}
+
+local_server::~local_server()
+{
+    m_stop = true;
+    m_thread.join();
+
+    for (auto &t : m_conns) {
+        t.join();
+    }
+
+    close(m_fd);
+}
+
+void local_server::listen_loop()
+{
+    struct pollfd pfd = { m_fd, POLLIN, 0 };
+
+    while (!m_stop) {
+        if (poll(&pfd, 1, 50) <= 0) continue;
+
+        int fd = accept4(m_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd == -1) continue;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_conns.emplace_back(&local_server::serve, this, fd);
+    }
+}
+
+/* one request per connection */
+void local_server::serve(int fd)
+{
+    std::string req;
+    char buf[16*1024];
+    ssize_t n;
+
+    requests++;
+
+    while (req.find("\r\n\r\n") == std::string::npos && (n = recv(fd, buf, sizeof(buf), 0)) > 0) {
+        req.append(buf, n);
+    }
+
+    auto header = [&] (const char *name) -> std::string {
+        const size_t p = req.find(std::string("\r\n") + name + ": ");
+        if (p == std::string::npos) return {};
+        const size_t v = p + strlen(name) + 4;
+        return req.substr(v, req.find("\r\n", v) - v);
+    };
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(m_delay));
+
+    const char *etag = "\"bench\"";
+    uint64_t from = 0, to = m_body.size();
+    std::string head;
+    unsigned long long a, b;
+
+    if (m_status != 200) {
+        head = "HTTP/1.1 " + std::to_string(m_status) + " Error\r\nContent-Length: 0\r\n";
+        to = 0;
+    } else if (header("If-None-Match") == etag) {
+        head = "HTTP/1.1 304 Not Modified\r\n";
+        to = 0;
+    } else if (sscanf(header("Range").c_str(), "bytes=%llu-%llu", &a, &b) >= 1 && a < m_body.size()) {
+        from = wrong_range ? a / 2 : a;
+        if (header("Range").back() != '-') to = std::min<uint64_t>(b + 1, m_body.size());
+        head = "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes " + std::to_string(from) + "-" +
+            std::to_string(to - 1) + "/" + std::to_string(m_body.size()) + "\r\n";
+    } else {
+        head = "HTTP/1.1 200 OK\r\n";
+    }
+
+    if (m_status == 200) {
+        head += "Content-Length: " + std::to_string(to - from) + "\r\n"
+            "Accept-Ranges: bytes\r\nETag: " + std::string(etag) + "\r\n";
+    }
+
+    head += "Connection: close\r\n\r\n";
+    send(fd, head.data(), head.size(), MSG_NOSIGNAL);
+
+    const size_t step = 16*1024;
+
+    for (uint64_t pos = from; pos < to && !m_stop; pos += step) {
+        const size_t len = std::min<uint64_t>(step, to - pos);
+
+        if (send(fd, m_body.data() + pos, len, MSG_NOSIGNAL) != static_cast<ssize_t>(len)) break;
+        if (m_rate > 0) std::this_thread::sleep_for(std::chrono::duration<double>(len / m_rate));
+    }
+
+    close(fd);
+}
+
+/* directories and files of a tree with <files> files that is <depth>
+ * levels deep, leaf directories holding FILES_PER_DIR files each */
+static std::vector<file_entry> layout(int files, int depth)
+{
+    std::vector<file_entry> list;
+    const int leaves = (files + FILES_PER_DIR - 1) / FILES_PER_DIR;
+    const int fanout = std::max(2, static_cast<int>(ceil(pow(leaves, 1.0 / std::max(1, depth)))));
+    std::vector<std::string> made;
+
+    for (int leaf = 0, n = 0; leaf < leaves; leaf++) {
+        std::string dir;
+
+        for (int level = 0, rest = leaf; level < depth; level++, rest /= fanout) {
+            dir += "d" + std::to_string(rest % fanout) + "/";
+
+            if (std::find(made.begin(), made.end(), dir) == made.end()) {
+                made.push_back(dir);
+                list.push_back({ dir, true });
+            }
+        }
+
+        for (int i = 0; i < FILES_PER_DIR && n < files; i++, n++) {
+            list.push_back({ dir + "f" + std::to_string(i) + ".dat", false });
+        }
+    }
+
+    return list;
+}
+
+static void fill(std::vector<char> &buf, unsigned seed)
+{
+    /* somewhat compressible, like game data */
+    for (auto &c : buf) {
+        seed = seed * 1103515245 + 12345;
+        c = static_cast<char>((seed >> 16) & 0x3f);
+    }
+}
+
+static bool make_tree(const std::string &root, const std::vector<file_entry> &list, int size)
+{
+    std::vector<char> buf(size);
+    unsigned seed = 1;
+
+    if (mkdir(root.c_str(), 0755) != 0) return false;
+
+    for (const auto &e : list) {
+        const std::string path = root + "/" + e.path;
+
+        if (e.dir) {
+            if (mkdir(path.c_str(), 0755) != 0) return false;
+            continue;
+        }
+
+        fill(buf, seed++);
+
+        FILE *fp = fopen(path.c_str(), "wb");
+        if (!fp) return false;
+        fwrite(buf.data(), 1, buf.size(), fp);
+        fclose(fp);
+    }
+
+    return true;
+}
+
+static void tar_header(std::string &out, const std::string &name, bool dir, size_t size)
+{
+    char h[512];
+    memset(h, 0, sizeof(h));
+
+    snprintf(h, 100, "%s", name.c_str());
+    snprintf(h + 100, 8, "%07o", dir ? 0755 : 0644);
+    snprintf(h + 108, 8, "%07o", 0);
+    snprintf(h + 116, 8, "%07o", 0);
+    snprintf(h + 124, 12, "%011zo", size);
+    snprintf(h + 136, 12, "%011o", 0);
+    h[156] = dir ? '5' : '0';
+    memcpy(h + 257, "ustar", 6);
+    memcpy(h + 263, "00", 2);
+
+    unsigned sum = 0;
+    memset(h + 148, ' ', 8);
+    for (unsigned char c : h) sum += c;
+    snprintf(h + 148, 8, "%06o", sum);
+
+    out.append(h, sizeof(h));
+}
+
+/* a tar.gz archive like the ones from GitHub, with the
+ * game directory as the top-level entry */
+static std::string make_archive(const std::string &top, const std::vector<file_entry> &list, int size)
+{
+    std::string tar;
+    std::vector<char> buf(size);
+    unsigned seed = 1;
+
+    tar_header(tar, top + "/", true, 0);
+
+    for (const auto &e : list) {
+        tar_header(tar, top + "/" + e.path, e.dir, e.dir ? 0 : size);
+
+        if (!e.dir) {
+            fill(buf, seed++);
+            tar.append(buf.data(), buf.size());
+            tar.append((512 - size % 512) % 512, '\0');
+        }
+    }
+
+    tar.append(1024, '\0');
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    deflateInit2(&zs, 6, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+
+    std::string gz(deflateBound(&zs, tar.size()), '\0');
+    zs.next_in = reinterpret_cast<Bytef *>(&tar[0]);
+    zs.avail_in = tar.size();
+    zs.next_out = reinterpret_cast<Bytef *>(&gz[0]);
+    zs.avail_out = gz.size();
+    deflate(&zs, Z_FINISH);
+    gz.resize(zs.total_out);
+    deflateEnd(&zs);
+
+    return gz;
+}
+
+static void remove_tree(const std::string &path)
+{
+    tree_remover rm;
+    rm.add(path);
+    rm.run();
+}
+
+static void bench_is_full_directory(const options &opt, const std::string &confdir, int files)
+{
+    std::vector<double> full, empty;
+    const std::string dir = confdir + games[0];
+    const std::string emptydir = confdir + "empty";
+    const int n = opt.runs * 200;
+
+    mkdir(emptydir.c_str(), 0755);
+
+    for (int i = 0; i < n; i++) {
+        full.push_back(run([&] { is_full_directory(dir.c_str()); }));
+        empty.push_back(run([&] { is_full_directory(emptydir.c_str()); }));
+    }
+
+    rmdir(emptydir.c_str());
+
+    report("is_full_directory", opt, files, full, 1, 0);
+    report("is_full_directory.empty", opt, files, empty, 1, 0);
+}
+
+/* what all_directories_exist() does at startup: with a valid index
+ * file, and without one (first start or after a change) */
+static void bench_install_index(const options &opt, const std::string &confdir, int files)
+{
+    std::vector<double> cached, scan;
+    const std::vector<std::string> dirs(games, games + 3);
+    const std::string indexfile = confdir + "installed";
+    const int n = opt.runs * 20;
+
+    /* create the index file */
+    install_index(confdir, dirs).load();
+
+    for (int i = 0; i < n; i++) {
+        cached.push_back(run([&] {
+            install_index idx(confdir, dirs);
+            idx.load();
+            idx.all_installed();
+        }));
+
+        unlink(indexfile.c_str());
+
+        scan.push_back(run([&] {
+            install_index idx(confdir, dirs);
+            idx.load();
+            idx.all_installed();
+        }));
+    }
+
+    report("all_directories_exist.cached", opt, files, cached, 3, 0);
+    report("all_directories_exist.scan", opt, files, scan, 3, 0);
+}
+
+/* what remove_data() does: all three trees at once */
+static void bench_remove(const options &opt, const std::string &confdir, int files,
+                         const std::vector<file_entry> &list)
+{
+    std::vector<double> ms;
+    size_t entries = 0;
+
+    for (int i = 0; i < opt.runs; i++) {
+        tree_remover rm;
+
+        for (int j = 0; j < 3; j++) {
+            const std::string root = confdir + games[j];
+            remove_tree(root);
+            make_tree(root, list, opt.size);
+            rm.add(root);
+        }
+
+        /* don't time the writeback of the new files */
+        sync();
+
+        ms.push_back(run([&] { rm.run(); }));
+        entries = rm.removed;
+    }
+
+    report("remove_data", opt, files, ms, entries, 0);
+}
+
+static void bench_extract(const options &opt, const std::string &confdir, int files,
+                          const std::vector<file_entry> &list)
+{
+    std::vector<double> ms;
+    const std::string archive = make_archive(games[0], list, opt.size);
+    const std::string dest = confdir + "staging";
+    const size_t chunk = 64*1024;
+
+    for (int i = 0; i < opt.runs; i++) {
+        remove_tree(dest);
+        mkdir(dest.c_str(), 0755);
+        sync();
+
+        /* fed in network sized chunks */
+        ms.push_back(run([&] {
+            tar_extractor tar(dest);
+
+            for (size_t pos = 0; pos < archive.size(); pos += chunk) {
+                if (!tar.write(archive.data() + pos, std::min(chunk, archive.size() - pos))) {
+                    fprintf(stderr, "extract: %s\n", tar.error().c_str());
+                    exit(1);
+                }
+            }
+
+            if (!tar.finish()) {
+                fprintf(stderr, "extract: %s\n", tar.error().c_str());
+                exit(1);
+            }
+        }));
+    }
+
+    remove_tree(dest);
+
+    report("extract", opt, files, ms, files, static_cast<double>(files) * opt.size);
+}
+
+/* same archive repacked into frames (--repack), extracted on all cores */
+static void bench_extract_pack(const options &opt, const std::string &confdir, int files,
+                               const std::vector<file_entry> &list)
+{
+    std::vector<double> ms;
+    const std::string archive = make_archive(games[0], list, opt.size);
+    const std::string gz = confdir + "bench.tar.gz";
+    const std::string pack = confdir + "bench.pack";
+    const std::string dest = confdir + "staging";
+    const int threads = std::max<int>(std::thread::hardware_concurrency(), 1);
+    std::string err;
+
+    FILE *fp = fopen(gz.c_str(), "wb");
+
+    if (!fp || fwrite(archive.data(), 1, archive.size(), fp) != archive.size() ||
+        fclose(fp) != 0 || !pack_archive(gz, pack, err))
+    {
+        fprintf(stderr, "pack: %s\n", err.empty() ? "cannot write archive" : err.c_str());
+        exit(1);
+    }
+
+    for (int i = 0; i < opt.runs; i++) {
+        remove_tree(dest);
+        mkdir(dest.c_str(), 0755);
+        sync();
+
+        ms.push_back(run([&] {
+            pack_extractor px(pack, dest);
+
+            if (!px.run(threads)) {
+                fprintf(stderr, "extract.pack: %s\n", px.error().c_str());
+                exit(1);
+            }
+        }));
+    }
+
+    remove_tree(dest);
+    remove(gz.c_str());
+    remove(pack.c_str());
+
+    report("extract.pack", opt, files, ms, files, static_cast<double>(files) * opt.size);
+}
+
+/* download an archive through download_pool with --repack, then install
+ * it again from the pack, as the server says it hasn't changed */
+static void bench_download_repack(const options &opt, const std::string &confdir, int files,
+                                  const std::vector<file_entry> &list)
+{
+    std::vector<double> ms;
+    const std::string archive = make_archive(games[0], list, opt.size);
+    const std::string cache = confdir + "cache";
+    const std::string dest = confdir + "staging";
+    const std::string pack = cache + "/" + hasher::string(archive) + ".pack";
+    local_server server(archive);
+    struct stat st;
+
+    mkdir(cache.c_str(), 0755);
+
+    auto download = [&] (const char *what) {
+        manifest m;
+        tar_sink sink(dest, &m);
+        download_job job("bench", server.url("/bench.tar.gz"), &sink);
+        download_pool pool(1);
+
+        job.spool = confdir + "bench.tar.gz";
+        job.cache = cache;
+        job.repack = true;
+
+        pool.add(&job);
+        pool.start();
+        pool.wait();
+
+        check(job.state == DOWNLOAD_DONE, what, job.error);
+        check(m.size() == static_cast<size_t>(files), what, "wrong number of files extracted");
+    };
+
+    remove_tree(dest);
+    mkdir(dest.c_str(), 0755);
+    download("download.repack");
+    check(stat(pack.c_str(), &st) == 0, "download.repack", "no pack was created: " + pack);
+
+    for (int i = 0; i < opt.runs; i++) {
+        remove_tree(dest);
+        mkdir(dest.c_str(), 0755);
+        sync();
+
+        ms.push_back(run([&] { download("download.repack"); }));
+    }
+
+    remove_tree(dest);
+    remove_tree(cache);
+
+    report("download.repack", opt, files, ms, files, static_cast<double>(files) * opt.size);
+}
+
+/* a URL on a port nobody listens on */
+static std::string dead_url(const std::string &path)
+{
+    struct sockaddr_in sa;
+    socklen_t len = sizeof(sa);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    bind(fd, reinterpret_cast<struct sockaddr *>(&sa), sizeof(sa));
+    getsockname(fd, reinterpret_cast<struct sockaddr *>(&sa), &len);
+    close(fd);
+
+    return "http://127.0.0.1:" + std::to_string(ntohs(sa.sin_port)) + path;
+}
+
+/* probe stand-in mirrors with injected latency and throttling, check
+ * that they're ranked fastest first and that a download falls back
+ * past broken sources */
+static void bench_mirrors(const options &opt)
+{
+    std::vector<double> ms;
+    std::string body(4*1024*1024, '\0');
+    std::vector<char> buf(body.size());
+
+    fill(buf, 1);
+    body.assign(buf.begin(), buf.end());
+
+    local_server fast(body);
+    local_server late(body, 0.3);
+    local_server slow(body, 0, 512*1024);
+    local_server missing(body, 0, 0, 404);
+    const std::string dead = dead_url("/");
+
+    mirror_list mirrors;
+    mirrors.add(missing.url("/"), slow.url("/"));
+    mirrors.add(missing.url("/"), dead);
+    mirrors.add(missing.url("/"), late.url("/"));
+    mirrors.add(missing.url("/"), fast.url("/"));
+
+    const std::vector<std::string> expected = {
+        fast.url("/a.tar.gz"), late.url("/a.tar.gz"), slow.url("/a.tar.gz"),
+        missing.url("/a.tar.gz"), dead + "a.tar.gz"  /* failed ones keep their order */
+    };
+
+    for (int i = 0; i < opt.runs; i++) {
+        std::vector<std::string> sources = mirrors.sources(missing.url("/a.tar.gz"));
+        mirror_prober prober;
+
+        check(sources.size() == expected.size(), "mirrors.probe", "wrong number of sources");
+
+        ms.push_back(run([&] {
+            for (const auto &url : sources) prober.add(url);
+            prober.run();
+        }));
+
+        prober.rank(sources);
+
+        for (size_t j = 0; j < sources.size(); j++) {
+            check(sources[j] == expected[j], "mirrors.probe",
+                "rank " + std::to_string(j) + " is " + sources[j] + ", expected " + expected[j]);
+        }
+    }
+
+    report("mirrors.probe", opt, 0, ms, expected.size(), 0);
+
+    /* the broken sources are tried first */
+    memory_sink sink;
+    download_job job("mirrors", missing.url("/a.tar.gz"), &sink);
+    download_pool pool(1);
+    const int requests = missing.requests;
+
+    job.sources = { dead + "a.tar.gz", missing.url("/a.tar.gz"), fast.url("/a.tar.gz") };
+    pool.add(&job);
+    pool.start();
+    pool.wait();
+
+    check(job.state == DOWNLOAD_DONE, "mirrors.fallback", job.error);
+    check(sink.data() == body, "mirrors.fallback", "wrong data");
+    check(missing.requests == requests + 1, "mirrors.fallback", "broken source was not tried");
+}
+
+/* resume an interrupted download from a server that sends the wrong
+ * range; the job has to start over instead of taking it for the rest */
+static void check_resume(const std::string &confdir)
+{
+    std::string body(1024*1024, '\0');
+    std::vector<char> buf(body.size());
+
+    fill(buf, 2);
+    body.assign(buf.begin(), buf.end());
+
+    local_server server(body);
+    memory_sink sink;
+    download_job job("resume", server.url("/resume.tar.gz"), &sink);
+    download_pool pool(1);
+    download_state st;
+    const uint64_t offset = body.size() / 4;
+
+    job.spool = confdir + "resume.tar.gz";
+    st.url = job.url;
+    st.etag = "\"bench\"";
+    st.offset = offset;
+
+    FILE *fp = fopen((job.spool + ".part").c_str(), "wbe");
+    check(fp && fwrite(body.data(), 1, offset, fp) == offset && fclose(fp) == 0 &&
+          st.save(job.spool + ".state"), "download.resume", "cannot write the partial download");
+
+    server.wrong_range = true;
+    pool.add(&job);
+    pool.start();
+    pool.wait();
+
+    check(job.state == DOWNLOAD_DONE, "download.resume", job.error);
+    check(sink.data() == body, "download.resume", "wrong data");
+    check(server.requests == 2, "download.resume", "the download wasn't started over");
+    check(access((job.spool + ".part").c_str(), F_OK) != 0, "download.resume", "partial download was left behind");
+}
+
+static std::vector<int> parse_list(const char *s)
+{
+    std::vector<int> v;
+
+    for (const char *p = s; *p; ) {
+        char *end;
+        long n = strtol(p, &end, 10);
+        if (end == p) break;
+        if (n > 0) v.push_back(n);
+        p = (*end == ',') ? end + 1 : end;
+    }
+
+    return v;
+}
+
+int main(int argc, char **argv)
+{
+    options opt;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--files=", 8) == 0) {
+            opt.files = parse_list(argv[i] + 8);
+        } else if (strncmp(argv[i], "--depth=", 8) == 0) {
+            opt.depth = std::max(0, atoi(argv[i] + 8));
+        } else if (strncmp(argv[i], "--size=", 7) == 0) {
+            opt.size = std::max(0, atoi(argv[i] + 7));
+        } else if (strncmp(argv[i], "--runs=", 7) == 0) {
+            opt.runs = std::max(1, atoi(argv[i] + 7));
+        } else {
+            fprintf(stderr, "usage: %s [--files=N,N,...] [--depth=N] [--size=BYTES] [--runs=N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    /* temporary $HOME */
+    const char *tmp = getenv("TMPDIR");
+    std::string home = std::string((tmp && *tmp) ? tmp : "/tmp") + "/launcher-bench.XXXXXX";
+
+    if (!mkdtemp(&home[0])) {
+        perror("mkdtemp()");
+        return 1;
+    }
+
+    setenv("HOME", home.c_str(), 1);
+
+    const std::string confdir = home + "/.alephone/";
+    mkdir(confdir.c_str(), 0755);
+
+    for (int files : opt.files) {
+        const std::vector<file_entry> list = layout(files, opt.depth);
+
+        for (int j = 0; j < 3; j++) {
+            if (!make_tree(confdir + games[j], list, opt.size)) {
+                perror("cannot create test data");
+                remove_tree(home);
+                return 1;
+            }
+        }
+
+        bench_is_full_directory(opt, confdir, files);
+        bench_install_index(opt, confdir, files);
+        bench_remove(opt, confdir, files, list);
+        bench_extract(opt, confdir, files, list);
+        bench_extract_pack(opt, confdir, files, list);
+        bench_download_repack(opt, confdir, files, list);
+
+        for (int j = 0; j < 3; j++) {
+            remove_tree(confdir + games[j]);
+        }
+    }
+
+    bench_mirrors(opt);
+    check_resume(confdir);
+
+    remove_tree(home);
+
+    return 0;
+}
@@ -0,0 +1,192 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "catalog.hpp"
+
+
+bool parse_color(const std::string &s, uint32_t &color)
+{
+    const char *p = s.c_str();
+
+    if (*p == '#') {
+        p++;
+    } else if (strncmp(p, "0x", 2) == 0) {
+        p += 2;
+    }
+
+    if (strlen(p) != 6 || strspn(p, "0123456789abcdefABCDEF") != 6) {
+        return false;
+    }
+
+    color = strtoul(p, NULL, 16);
+
+    return true;
+}
+
+static std::string trim(const char *p)
+{
+    const char *end = p + strlen(p);
+
+    while (*p == ' ' || *p == '\t') p++;
+
+    while (end > p && strchr(" \t\r\n", end[-1])) end--;
+
+    return std::string(p, end - p);
+}
+
+/* files and directories of the launcher in ~/.alephone */
+static bool reserved(const std::string &d)
+{
+    static const char *names[] = {
+        "alephone.png", "cache", "catalog", "dedupecache", "engine", "hashcache",
+        "icon", "installed", "mirrors", "scenarios", "staging", NULL
+    };
+
+    /* a download of <dir> is kept as "<dir>.tar.gz" and its
+     * file list as "<dir>.manifest" */
+    static const char *suffixes[] = {
+        ".manifest", ".tar.gz", ".part", ".state", NULL
+    };
+
+    for (const char **p = names; *p; p++) {
+        if (d == *p) return true;
+    }
+
+    for (const char **p = suffixes; *p; p++) {
+        const size_t len = strlen(*p);
+        if (d.size() > len && d.compare(d.size() - len, len, *p) == 0) return true;
+    }
+
+    return d.compare(0, 6, "trash.") == 0 || d.compare(0, 12, "download.log") == 0;
+}
+
+/* the directory is created, replaced and deleted by the launcher,
+ * so it must be a plain name that doesn't collide with its own files */
+bool catalog::check(const catalog_entry &e, int line)
+{
+    const std::string &d = e.dir;
+    const char *msg = NULL;
+
+    if (d.empty()) {
+        msg = "no \"dir\" given";
+    } else if (d[0] == '.' || d.find('/') != std::string::npos) {
+        msg = "\"dir\" must be a plain directory name";
+    } else if (reserved(d)) {
+        msg = "\"dir\" is reserved";
+    } else if (!e.url.empty() && e.url.compare(0, 7, "http://") != 0 &&
+               e.url.compare(0, 8, "https://") != 0)
+    {
+        msg = "\"url\" must be a http or https URL";
+    }
+
+    if (msg) {
+        m_error += "line " + std::to_string(line) + " [" + e.name + "]: " + msg + "\n";
+        return false;
+    }
+
+    return true;
+}
+
+void catalog::add(const catalog_entry &e)
+{
+    auto it = m_dirs.find(e.dir);
+
+    if (it != m_dirs.end()) {
+        m_entries[it->second] = e;
+        return;
+    }
+
+    m_dirs[e.dir] = m_entries.size();
+    m_entries.push_back(e);
+}
+
+bool catalog::load(const std::string &path)
+{
+    FILE *fp = fopen(path.c_str(), "re");
+    if (!fp) return false;
+
+    char buf[4096];
+    catalog_entry e;
+    bool in_entry = false;
+    int line = 0, start = 0;
+
+    auto flush = [&] () {
+        if (in_entry && check(e, start)) add(e);
+        in_entry = false;
+    };
+
+    while (fgets(buf, sizeof(buf), fp)) {
+        const std::string s = trim(buf);
+        line++;
+
+        if (s.empty() || s[0] == '#' || s[0] == ';') {
+            continue;
+        }
+
+        if (s[0] == '[' && s.back() == ']') {
+            flush();
+            e = catalog_entry();
+            e.name = trim(s.substr(1, s.size() - 2).c_str());
+            in_entry = true;
+            start = line;
+            continue;
+        }
+
+        const size_t eq = s.find('=');
+
+        if (!in_entry || eq == std::string::npos) {
+            m_error += "line " + std::to_string(line) + ": syntax error\n";
+            continue;
+        }
+
+        const std::string key = trim(s.substr(0, eq).c_str());
+        const std::string val = trim(s.substr(eq + 1).c_str());
+
+        if (key == "dir") {
+            e.dir = val;
+        } else if (key == "url") {
+            e.url = val;
+        } else if (key == "repo") {
+            e.repo = val;
+        } else if (key == "color") {
+            if (!parse_color(val, e.color)) {
+                m_error += "line " + std::to_string(line) + ": invalid color: " + val + "\n";
+            }
+        } else {
+            m_error += "line " + std::to_string(line) + ": unknown key: " + key + "\n";
+        }
+    }
+
+    flush();
+    fclose(fp);
+
+    return true;
+}
@@ -0,0 +1,96 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef CATALOG_HPP
+#define CATALOG_HPP
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+
+/* a game or scenario the launcher can start */
+struct catalog_entry
+{
+    std::string name;
+
+    /* data directory, relative to "~/.alephone"; scenarios that
+     * were found by the scanner have an absolute path instead */
+    std::string dir;
+
+    /* tar.gz archive whose top-level directory is <dir>;
+     * entries without one can't be downloaded */
+    std::string url;
+
+    /* Github repository ("owner/name") of the "master" branch of
+     * the archive; only entries with one can be updated file by file */
+    std::string repo;
+
+    /* logo color as 0xRRGGBB */
+    uint32_t color = 0x959595;
+};
+
+/* List of games and scenarios. The catalog file has one section per
+ * entry, named after the entry, with "key=value" lines:
+ *
+ *   [Marathon Rubicon X]
+ *   dir=rubicon-x
+ *   url=https://example.org/rubicon-x.tar.gz
+ *   color=#c03020
+ *
+ * Keys are "dir" (required), "url", "repo" and "color"; empty lines
+ * and lines starting with '#' or ';' are ignored. */
+class catalog
+{
+private:
+
+    std::vector<catalog_entry> m_entries;
+    std::unordered_map<std::string, size_t> m_dirs;
+    std::string m_error;
+
+    bool check(const catalog_entry &e, int line);
+
+public:
+
+    /* an entry with the same directory is replaced */
+    void add(const catalog_entry &e);
+
+    /* add all entries of a catalog file; returns false if it can't be
+     * read; invalid entries are skipped and reported in error() */
+    bool load(const std::string &path);
+
+    const std::string &error() const {return m_error;}
+
+    bool has(const std::string &dir) const {return m_dirs.count(dir) > 0;}
+
+    size_t size() const {return m_entries.size();}
+    const catalog_entry &at(size_t i) const {return m_entries.at(i);}
+    const std::vector<catalog_entry> &entries() const {return m_entries;}
+};
+
+/* "#rrggbb", "rrggbb" or "0xrrggbb"; returns false on error */
+bool parse_color(const std::string &s, uint32_t &color);
+
+#endif /* CATALOG_HPP */
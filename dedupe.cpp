@@ -0,0 +1,435 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+
+#include "dedupe.hpp"
+#include "trace.hpp"
+#include "verify.hpp"
+
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+
+#define TMP_SUFFIX ".dedupe"
+
+
+static bool ends_with(const char *s, const char *suffix)
+{
+    const size_t a = strlen(s), b = strlen(suffix);
+    return a >= b && strcmp(s + a - b, suffix) == 0;
+}
+
+/* compare two files byte by byte */
+static bool same_content(const std::string &a, const std::string &b)
+{
+    int fa = open(a.c_str(), O_RDONLY | O_CLOEXEC);
+    int fb = open(b.c_str(), O_RDONLY | O_CLOEXEC);
+    bool same = (fa != -1 && fb != -1);
+    std::vector<char> ba(64*1024), bb(64*1024);
+
+    if (same) {
+        posix_fadvise(fa, 0, 0, POSIX_FADV_SEQUENTIAL);
+        posix_fadvise(fb, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    while (same) {
+        ssize_t na = read(fa, ba.data(), ba.size());
+        ssize_t nb = (na > 0) ? read(fb, bb.data(), na) : read(fb, bb.data(), 1);
+
+        if (na < 0 || na != nb) {
+            same = false;
+        } else if (na == 0) {
+            break;
+        } else {
+            same = (memcmp(ba.data(), bb.data(), na) == 0);
+        }
+    }
+
+    if (fa != -1) close(fa);
+    if (fb != -1) close(fb);
+
+    return same;
+}
+
+/* all extents of a file; false if they can't be read */
+static bool extents(const std::string &path, std::vector<struct fiemap_extent> &out)
+{
+    const unsigned batch = 64;
+    union {
+        struct fiemap fm;
+        char buf[sizeof(struct fiemap) + batch * sizeof(struct fiemap_extent)];
+    } u;
+    uint64_t start = 0;
+    bool last = false;
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return false;
+
+    out.clear();
+
+    while (!last) {
+        memset(&u, 0, sizeof(u));
+        u.fm.fm_start = start;
+        u.fm.fm_length = FIEMAP_MAX_OFFSET - start;
+        u.fm.fm_flags = FIEMAP_FLAG_SYNC;
+        u.fm.fm_extent_count = batch;
+
+        if (ioctl(fd, FS_IOC_FIEMAP, &u.fm) != 0) {
+            close(fd);
+            return false;
+        }
+
+        if (u.fm.fm_mapped_extents == 0) break;
+
+        for (unsigned i = 0; i < u.fm.fm_mapped_extents; i++) {
+            const struct fiemap_extent &e = u.fm.fm_extents[i];
+            out.push_back(e);
+            start = e.fe_logical + e.fe_length;
+            if (e.fe_flags & FIEMAP_EXTENT_LAST) last = true;
+        }
+    }
+
+    close(fd);
+
+    return true;
+}
+
+/* true if both files consist of the very same shared extents,
+ * i.e. they were reflinked before */
+static bool shares_extents(const std::string &a, const std::string &b)
+{
+    std::vector<struct fiemap_extent> ea, eb;
+
+    if (!extents(a, ea) || !extents(b, eb) || ea.empty() || ea.size() != eb.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < ea.size(); i++) {
+        if (!(ea[i].fe_flags & FIEMAP_EXTENT_SHARED) ||
+            ea[i].fe_logical != eb[i].fe_logical ||
+            ea[i].fe_physical != eb[i].fe_physical ||
+            ea[i].fe_length != eb[i].fe_length)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* same inode with the same size and modification time */
+static bool same_file(const struct stat &a, const struct stat &b)
+{
+    return a.st_dev == b.st_dev && a.st_ino == b.st_ino && a.st_size == b.st_size &&
+        a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec;
+}
+
+/* true if <path> is still the file that was scanned as <st> */
+static bool unchanged(const std::string &path, const struct stat &st)
+{
+    struct stat now;
+    return lstat(path.c_str(), &now) == 0 && same_file(now, st);
+}
+
+
+file_deduper::file_deduper(hash_cache &cache, int threads)
+: m_cache(cache), m_threads(threads)
+{
+    if (m_threads < 1) {
+        m_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+void file_deduper::walk(const std::string &path, dev_t dev)
+{
+    DIR *d = opendir(path.c_str());
+    if (!d) return;
+
+    while (struct dirent *e = readdir(d)) {
+        struct stat st;
+
+        if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0 ||
+            fstatat(dirfd(d), e->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+        {
+            continue;
+        }
+
+        const std::string sub = path + "/" + e->d_name;
+
+        if (S_ISDIR(st.st_mode) && st.st_dev == dev) {
+            walk(sub, dev);
+        } else if (S_ISREG(st.st_mode) && !ends_with(e->d_name, TMP_SUFFIX)) {
+            m_inodes.push_back({ st, { sub }, {} });
+            files++;
+        }
+    }
+
+    closedir(d);
+}
+
+void file_deduper::worker()
+{
+    size_t i;
+
+    while (!m_cancel && (i = m_next++) < m_tasks.size()) {
+        inode *n = m_tasks[i];
+
+        if (!m_cache.lookup(n->st, n->sha1)) {
+            n->sha1 = git_blob_sha1_file(n->paths[0], n->st);
+            if (!n->sha1.empty()) m_cache.store(n->st, n->sha1);
+            hashed++;
+            hashed_bytes += n->st.st_size;
+        }
+    }
+}
+
+void file_deduper::run()
+{
+    TRACE_SCOPE("dedupe");
+    std::vector<std::thread> threads;
+    struct stat st;
+
+    for (const auto &root : m_roots) {
+        if (stat(root.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+            walk(root, st.st_dev);
+        }
+    }
+
+    /* paths that are hard links of each other already belong to one inode */
+    std::sort(m_inodes.begin(), m_inodes.end(), [] (const inode &a, const inode &b) {
+        if (a.st.st_dev != b.st.st_dev) return a.st.st_dev < b.st.st_dev;
+        if (a.st.st_ino != b.st.st_ino) return a.st.st_ino < b.st.st_ino;
+        return a.paths[0] < b.paths[0];
+    });
+
+    size_t n = 0;
+
+    for (size_t i = 0; i < m_inodes.size(); i++) {
+        if (n > 0 && m_inodes[n-1].st.st_dev == m_inodes[i].st.st_dev &&
+            m_inodes[n-1].st.st_ino == m_inodes[i].st.st_ino)
+        {
+            m_inodes[n-1].paths.push_back(m_inodes[i].paths[0]);
+        } else {
+            if (n != i) m_inodes[n] = std::move(m_inodes[i]);
+            n++;
+        }
+    }
+
+    m_inodes.resize(n);
+
+    /* only inodes of the same size on the same file system can be shared */
+    std::sort(m_inodes.begin(), m_inodes.end(), [] (const inode &a, const inode &b) {
+        if (a.st.st_dev != b.st.st_dev) return a.st.st_dev < b.st.st_dev;
+        return a.st.st_size < b.st.st_size;
+    });
+
+    auto same_size = [] (const inode &a, const inode &b) {
+        return a.st.st_dev == b.st.st_dev && a.st.st_size == b.st.st_size;
+    };
+
+    for (size_t i = 0; i < m_inodes.size(); i++) {
+        if (static_cast<uint64_t>(m_inodes[i].st.st_size) >= m_min_size &&
+            ((i > 0 && same_size(m_inodes[i-1], m_inodes[i])) ||
+             (i + 1 < m_inodes.size() && same_size(m_inodes[i], m_inodes[i+1]))))
+        {
+            m_tasks.push_back(&m_inodes[i]);
+        }
+    }
+
+    const int nthreads = std::min<size_t>(m_threads, m_tasks.size());
+
+    for (int i = 0; i < nthreads; i++) {
+        threads.emplace_back(&file_deduper::worker, this);
+    }
+
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    /* m_tasks is still sorted by size; sort each run of the same
+     * size by hash and keep the inode with the most links */
+    for (size_t i = 0; i < m_tasks.size() && !m_cancel; ) {
+        size_t end = i + 1;
+
+        while (end < m_tasks.size() && same_size(*m_tasks[i], *m_tasks[end])) {
+            end++;
+        }
+
+        std::sort(m_tasks.begin() + i, m_tasks.begin() + end, [] (const inode *a, const inode *b) {
+            if (a->sha1 != b->sha1) return a->sha1 < b->sha1;
+            if (a->paths.size() != b->paths.size()) return a->paths.size() > b->paths.size();
+            return a->paths[0] < b->paths[0];
+        });
+
+        for (size_t j = i + 1, keep = i; j < end; j++) {
+            if (m_tasks[j]->sha1 != m_tasks[keep]->sha1) {
+                keep = j;
+            } else if (!m_tasks[j]->sha1.empty()) {
+                merge(*m_tasks[keep], *m_tasks[j]);
+            }
+        }
+
+        i = end;
+    }
+}
+
+/* let all paths of <dup> share the data of <keep> */
+void file_deduper::merge(inode &keep, const inode &dup)
+{
+    const dev_t dev = dup.st.st_dev;
+    const bool try_reflink = (m_no_reflink.count(dev) == 0);
+    size_t done = 0;
+
+    if (try_reflink && shares_extents(keep.paths[0], dup.paths[0])) {
+        shared++;
+        return;
+    }
+
+    if (!same_content(keep.paths[0], dup.paths[0])) {
+        return;
+    }
+
+    for (const auto &path : dup.paths) {
+        if (m_cancel) return;
+
+        if (m_no_reflink.count(dev) == 0 && reflink(keep, dup, path)) {
+            cloned++;
+        } else if (hardlink(keep, dup, path)) {
+            linked++;
+        } else {
+            failed++;
+            continue;
+        }
+
+        done++;
+    }
+
+    /* the data of <dup> is gone once its last path was replaced */
+    if (done == dup.paths.size()) {
+        saved += dup.st.st_size;
+    }
+}
+
+/* replace <path> with a reflink copy of <keep>, with the
+ * permissions and times of <dup> */
+bool file_deduper::reflink(const inode &keep, const inode &dup, const std::string &path)
+{
+    const std::string tmp = path + TMP_SUFFIX;
+    const struct timespec times[2] = { dup.st.st_atim, dup.st.st_mtim };
+    struct stat st;
+
+    int src = open(keep.paths[0].c_str(), O_RDONLY | O_CLOEXEC);
+    if (src == -1) return false;
+
+    /* the source may have been replaced since it was compared */
+    if (fstat(src, &st) != 0 || !same_file(st, keep.st)) {
+        close(src);
+        return false;
+    }
+
+    unlink(tmp.c_str());
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+
+    if (fd == -1) {
+        close(src);
+        return false;
+    }
+
+    if (ioctl(fd, FICLONE, src) != 0) {
+        /* not supported by this file system; use hard links from now on */
+        if (errno == EOPNOTSUPP || errno == ENOTTY || errno == EINVAL || errno == EXDEV) {
+            m_no_reflink.insert(dup.st.st_dev);
+        }
+
+        close(src);
+        close(fd);
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    close(src);
+
+    bool ok = (fchmod(fd, dup.st.st_mode & 07777) == 0 && futimens(fd, times) == 0 &&
+               fstat(fd, &st) == 0);
+
+    /* don't put old content back over a file that was just updated */
+    if (close(fd) != 0 || !ok || !unchanged(path, dup.st) || rename(tmp.c_str(), path.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    /* so that the next run doesn't need to hash it again */
+    m_cache.store(st, keep.sha1);
+
+    return true;
+}
+
+/* replace <path> with a hard link to <keep>, which is made read-only */
+bool file_deduper::hardlink(inode &keep, const inode &dup, const std::string &path)
+{
+    const std::string tmp = path + TMP_SUFFIX;
+
+    if (!unchanged(keep.paths[0], keep.st)) {
+        return false;
+    }
+
+    if (keep.st.st_mode & 0222) {
+        if (chmod(keep.paths[0].c_str(), keep.st.st_mode & 07555) != 0) {
+            return false;
+        }
+
+        keep.st.st_mode &= ~0222;
+    }
+
+    unlink(tmp.c_str());
+
+    if (::link(keep.paths[0].c_str(), tmp.c_str()) != 0) {
+        return false;
+    }
+
+    /* the source may have been replaced in the meantime and the
+     * target must not get old content back */
+    if (!unchanged(tmp, keep.st) || !unchanged(path, dup.st) || rename(tmp.c_str(), path.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    keep.paths.push_back(path);
+
+    return true;
+}
@@ -0,0 +1,103 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef DEDUPE_HPP
+#define DEDUPE_HPP
+
+#include <atomic>
+#include <set>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+class hash_cache;
+class file_deduper;
+
+
+/* Finds files with the same content in several directory trees and lets
+ * them share their data: with a reflink (FICLONE) where the file system
+ * supports it, otherwise with a hard link, in which case the shared file
+ * is made read-only so that it can't be changed for all trees at once.
+ * Files are only hashed if another file has the same size and are
+ * compared byte by byte before anything is replaced. Replacements are
+ * renamed over the old file, so a reader always sees a complete file;
+ * a file that changed since it was scanned is left alone. */
+class file_deduper
+{
+private:
+
+    struct inode
+    {
+        struct stat st;
+        std::vector<std::string> paths;
+        std::string sha1;
+    };
+
+    hash_cache &m_cache;
+    std::vector<std::string> m_roots;
+    std::vector<inode> m_inodes;
+    std::vector<inode *> m_tasks;
+    std::atomic<size_t> m_next {0};
+    std::set<dev_t> m_no_reflink;
+    std::atomic<bool> m_cancel {false};
+    uint64_t m_min_size = 4096;
+    int m_threads;
+
+    void walk(const std::string &path, dev_t dev);
+    void worker();
+    void merge(inode &keep, const inode &dup);
+    bool reflink(const inode &keep, const inode &dup, const std::string &path);
+    bool hardlink(inode &keep, const inode &dup, const std::string &path);
+
+public:
+
+    /* results; can be read from any thread */
+    std::atomic<size_t> files {0};
+    std::atomic<size_t> hashed {0};
+    std::atomic<uint64_t> hashed_bytes {0};
+    std::atomic<size_t> cloned {0};
+    std::atomic<size_t> linked {0};
+    std::atomic<size_t> shared {0};  /* already reflinked */
+    std::atomic<size_t> failed {0};
+    std::atomic<uint64_t> saved {0};
+
+    file_deduper(hash_cache &cache, int threads = 0);
+
+    /* trees are not left on a different file system and
+     * symbolic links are not followed */
+    void add(const std::string &dir) {m_roots.push_back(dir);}
+
+    /* smaller files are left alone */
+    void min_size(uint64_t n) {m_min_size = n;}
+
+    /* blocks until all trees were deduplicated */
+    void run();
+
+    /* let run() return early; can be called from any thread */
+    void cancel() {m_cancel = true;}
+};
+
+#endif /* DEDUPE_HPP */
@@ -0,0 +1,961 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "download.hpp"
+#include "hash.hpp"
+#include "keyfile.hpp"
+#include "pack.hpp"
+#include "trace.hpp"
+
+/* how often the state of a spooled download is saved */
+#define DOWNLOAD_CHECKPOINT  (4*1024*1024)
+
+/* segmented downloads: only for files larger than SEGMENT_MIN_FILE;
+ * a segment should take about SEGMENT_SECONDS on its connection */
+#define SEGMENT_MIN_FILE     (16*1024*1024)
+#define SEGMENT_MIN          (1024*1024)
+#define SEGMENT_MAX          (32*1024*1024)
+#define SEGMENT_SECONDS      2.0
+#define SEGMENT_START        2     /* connections at first */
+#define SEGMENT_GAIN         1.15  /* add one more while throughput grows by this */
+#define SEGMENT_RETRIES      4
+
+
+/* same as "mkdir -p $(dirname path)" */
+static bool make_parents(const std::string &path)
+{
+    for (size_t p = 1; (p = path.find('/', p)) != std::string::npos; p++) {
+        if (mkdir(path.substr(0, p).c_str(), 0755) == -1 && errno != EEXIST) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+file_sink::~file_sink()
+{
+    if (m_fp) {
+        fclose(m_fp);
+        remove(m_tmp.c_str());
+    }
+
+    delete m_hash;
+}
+
+bool file_sink::begin(const http_response &)
+{
+    if (!make_parents(m_tmp) || (m_fp = fopen(m_tmp.c_str(), "wbe")) == NULL) {
+        m_error = m_tmp + ": " + strerror(errno);
+        return false;
+    }
+
+    if (!m_sha1.empty()) {
+        m_hash = new hasher(hasher::SHA1);
+        git_blob_header(*m_hash, m_size);
+    }
+
+    return true;
+}
+
+bool file_sink::write(const char *buf, size_t len)
+{
+    if (fwrite(buf, 1, len, m_fp) != len) {
+        m_error = m_tmp + ": " + strerror(errno);
+        return false;
+    }
+
+    if (m_hash) m_hash->update(buf, len);
+
+    return true;
+}
+
+bool file_sink::finish(std::string &err)
+{
+    int rv = fclose(m_fp);
+    m_fp = NULL;
+
+    if (m_hash && m_hash->hex() != m_sha1) {
+        err = m_path + ": checksum mismatch";
+        remove(m_tmp.c_str());
+        return false;
+    }
+
+    if (rv != 0 || rename(m_tmp.c_str(), m_path.c_str()) != 0) {
+        err = m_path + ": " + strerror(errno);
+        remove(m_tmp.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+
+bool tar_sink::write(const char *buf, size_t len)
+{
+    if (!m_tar.write(buf, len)) {
+        m_error = m_tar.error();
+        return false;
+    }
+
+    return true;
+}
+
+bool tar_sink::finish(std::string &err)
+{
+    if (!m_tar.finish()) {
+        err = m_tar.error();
+        return false;
+    }
+
+    return true;
+}
+
+
+bool tar_sink::extract_pack(const std::string &path, std::atomic<uint64_t> &progress, std::string &err)
+{
+    pack_extractor pack(path, m_dir);
+    int threads = std::thread::hardware_concurrency();
+
+    pack.record(m_manifest);
+    pack.top(m_top);
+    pack.progress(&progress);
+
+    if (!pack.run(std::max(threads, 1))) {
+        err = pack.error();
+        return false;
+    }
+
+    return true;
+}
+
+
+bool download_state::load(const std::string &path)
+{
+    keyfile kf;
+    if (!kf.load(path)) return false;
+
+    url = kf.get("url");
+    etag = kf.get("etag");
+    offset = kf.get_u64("offset");
+
+    return !url.empty();
+}
+
+bool download_state::save(const std::string &path) const
+{
+    keyfile kf;
+    kf.set("url", url);
+    kf.set("etag", etag);
+    kf.set("offset", offset);
+
+    return kf.save(path);
+}
+
+bool cache_entry::load(const std::string &path)
+{
+    keyfile kf;
+    if (!kf.load(path)) return false;
+
+    url = kf.get("url");
+    etag = kf.get("etag");
+    last_modified = kf.get("last-modified");
+    sha256 = kf.get("sha256");
+    size = kf.get_u64("size");
+
+    return !url.empty() && !sha256.empty();
+}
+
+bool cache_entry::save(const std::string &path) const
+{
+    keyfile kf;
+    kf.set("url", url);
+    kf.set("etag", etag);
+    kf.set("last-modified", last_modified);
+    kf.set("sha256", sha256);
+    kf.set("size", size);
+
+    return kf.save(path);
+}
+
+
+download_pool::~download_pool()
+{
+    cancel();
+    wait();
+}
+
+void download_pool::start()
+{
+    const int n = std::min<int>(m_workers, m_jobs.size());
+
+    for (int i = 0; i < n; i++) {
+        m_threads.emplace_back(&download_pool::worker, this);
+    }
+}
+
+void download_pool::wait()
+{
+    for (auto &t : m_threads) {
+        if (t.joinable()) t.join();
+    }
+
+    m_threads.clear();
+}
+
+bool download_pool::success() const
+{
+    for (const download_job *job : m_jobs) {
+        if (!job->optional && job->state != DOWNLOAD_DONE) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void download_pool::worker()
+{
+    http_block_sigpipe();
+
+    size_t i;
+
+    while ((i = m_next++) < m_jobs.size()) {
+        run_job(m_jobs[i]);
+        m_finished++;
+    }
+}
+
+static double now()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+
+namespace
+{
+
+/* Fetches the rest of a file over several connections at once. Every
+ * connection claims the next range of the file, sized so that it takes
+ * about SEGMENT_SECONDS at the throughput it had so far, and writes it
+ * into the spool at its offset. Connections are added one by one while
+ * the total throughput keeps growing. The data is passed on in order as
+ * soon as it's contiguous. */
+class segment_fetcher
+{
+private:
+
+    http_client &m_client;
+    download_job *m_job;
+    const std::atomic<bool> &m_cancel;
+    std::string m_url;
+    std::string m_validator;
+    int m_fd = -1;
+    int m_max;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::vector<std::thread> m_threads;
+    std::vector<std::pair<uint64_t, uint64_t>> m_retry;
+    std::map<uint64_t, uint64_t> m_written;  /* start -> end */
+    uint64_t m_next = 0;    /* first byte not claimed yet */
+    uint64_t m_ready = 0;   /* everything before is in the spool */
+    uint64_t m_end = 0;
+    int m_failures = 0;
+    std::string m_error;
+
+    std::atomic<bool> m_stop {false};
+    std::atomic<uint64_t> m_fetched {0};
+
+    bool claim(double rate, uint64_t &from, uint64_t &to);
+    void written(uint64_t from, uint64_t to);
+    void fail(uint64_t from, uint64_t to, const std::string &err, bool fatal);
+    void fetch(uint64_t from, uint64_t to, double &rate);
+    void worker();
+
+public:
+
+    segment_fetcher(http_client &c, download_job *job, const http_response &res,
+                    const std::atomic<bool> &cancel, int connections);
+    ~segment_fetcher();
+
+    /* fetch [from, end) into <spool> and pass it to <consume> in order */
+    bool run(const std::string &spool, uint64_t from, uint64_t end,
+             const std::function<bool (const char *, size_t)> &consume);
+
+    const std::string &error() const {return m_error;}
+};
+
+segment_fetcher::segment_fetcher(http_client &c, download_job *job, const http_response &res,
+                                 const std::atomic<bool> &cancel, int connections)
+: m_client(c), m_job(job), m_cancel(cancel), m_url(res.url), m_max(connections)
+{
+    const std::string etag = res.header("etag");
+
+    /* a weak ETag can't be used with If-Range */
+    if (!etag.empty() && etag.compare(0, 2, "W/") != 0) {
+        m_validator = etag;
+    } else {
+        m_validator = res.header("last-modified");
+    }
+}
+
+segment_fetcher::~segment_fetcher()
+{
+    m_stop = true;
+
+    for (auto &t : m_threads) {
+        t.join();
+    }
+
+    if (m_fd != -1) close(m_fd);
+}
+
+/* the next range to fetch; failed ranges come first */
+bool segment_fetcher::claim(double rate, uint64_t &from, uint64_t &to)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_stop) return false;
+
+    if (!m_retry.empty()) {
+        from = m_retry.back().first;
+        to = m_retry.back().second;
+        m_retry.pop_back();
+        return true;
+    }
+
+    if (m_next >= m_end) return false;
+
+    uint64_t len = std::max<uint64_t>(SEGMENT_MIN, rate * SEGMENT_SECONDS);
+    len = std::min<uint64_t>(len, SEGMENT_MAX);
+
+    /* don't leave a large tail to a single connection */
+    len = std::min<uint64_t>(len, std::max<uint64_t>(SEGMENT_MIN, (m_end - m_next) / m_threads.size()));
+
+    from = m_next;
+    to = m_next = std::min(m_end, m_next + len);
+
+    return true;
+}
+
+void segment_fetcher::written(uint64_t from, uint64_t to)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_written[from] = to;
+
+    auto it = m_written.find(m_ready);
+    if (it == m_written.end()) return;
+
+    while (it != m_written.end()) {
+        m_ready = it->second;
+        m_written.erase(it);
+        it = m_written.find(m_ready);
+    }
+
+    m_cond.notify_all();
+}
+
+void segment_fetcher::fail(uint64_t from, uint64_t to, const std::string &err, bool fatal)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (fatal || ++m_failures > SEGMENT_RETRIES) {
+        if (m_error.empty()) m_error = err;
+        m_stop = true;
+        m_cond.notify_all();
+        return;
+    }
+
+    m_retry.push_back({ from, to });
+}
+
+void segment_fetcher::fetch(uint64_t from, uint64_t to, double &rate)
+{
+    TRACE_SCOPE("segment", m_job->name);
+    http_response res;
+    std::vector<std::string> headers = {
+        "Range: bytes=" + std::to_string(from) + "-" + std::to_string(to - 1)
+    };
+    const std::string range = "bytes " + std::to_string(from) + "-" + std::to_string(to - 1) +
+        "/" + std::to_string(m_end);
+    uint64_t pos = from, done = from;
+    bool bad_range = false;
+    const double start = now();
+
+    if (!m_validator.empty()) {
+        headers.push_back("If-Range: " + m_validator);
+    }
+
+    auto sink = [&] (const char *buf, size_t len) -> bool {
+        /* the file has changed or the server ignored the range */
+        if (pos == from && (res.status != 206 || res.header("content-range") != range)) {
+            bad_range = true;
+            return false;
+        }
+
+        if (m_stop || m_cancel || len > to - pos || pwrite(m_fd, buf, len, pos) != static_cast<ssize_t>(len)) {
+            return false;
+        }
+
+        pos += len;
+        m_fetched += len;
+        m_job->received += len;
+
+        /* let the reader continue in steps, not only once per segment */
+        if (pos - done >= 256*1024 || pos == to) {
+            written(done, pos);
+            done = pos;
+        }
+
+        return true;
+    };
+
+    bool ok = m_client.get(m_url, headers, res, sink);
+
+    if (pos > done) written(done, pos);
+
+    if (bad_range) {
+        fail(from, to, "file has changed on the server: " + m_url, true);
+    } else if (pos < to) {
+        if (m_stop || m_cancel) return;
+
+        fail(pos, to, !ok ? res.error :
+            "HTTP error " + std::to_string(res.status) + ": " + m_url, false);
+    }
+
+    if (pos > from && now() > start) {
+        rate = (pos - from) / (now() - start);
+    }
+}
+
+void segment_fetcher::worker()
+{
+    http_block_sigpipe();
+
+    uint64_t from, to;
+    double rate = 0;
+
+    while (claim(rate, from, to)) {
+        fetch(from, to, rate);
+    }
+}
+
+bool segment_fetcher::run(const std::string &spool, uint64_t from, uint64_t end,
+                          const std::function<bool (const char *, size_t)> &consume)
+{
+    TRACE_SCOPE("segmented download", m_job->name);
+    std::vector<char> buf(256*1024);
+    uint64_t fed = from;
+    double last = now(), last_rate = 0;
+    uint64_t last_fetched = 0;
+    bool grow = true;
+
+    if ((m_fd = open(spool.c_str(), O_RDWR | O_CLOEXEC)) == -1) {
+        m_error = spool + ": " + strerror(errno);
+        return false;
+    }
+
+    m_next = m_ready = from;
+    m_end = end;
+
+    for (int i = 0; i < std::min(SEGMENT_START, m_max); i++) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_threads.emplace_back(&segment_fetcher::worker, this);
+    }
+
+    while (fed < end) {
+        uint64_t ready;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait_for(lock, std::chrono::milliseconds(250), [&] {
+                return m_stop || m_ready > fed;
+            });
+
+            if (m_stop) break;
+            ready = m_ready;
+
+            /* one more connection as long as it pays off */
+            const double t = now();
+
+            if (grow && t - last >= 1.0) {
+                const double rate = (m_fetched - last_fetched) / (t - last);
+
+                if (last_rate > 0 && rate < last_rate * SEGMENT_GAIN) {
+                    grow = false;
+                } else if (static_cast<int>(m_threads.size()) < m_max && m_next < m_end) {
+                    m_threads.emplace_back(&segment_fetcher::worker, this);
+                    last_rate = rate;
+                }
+
+                last = t;
+                last_fetched = m_fetched;
+            }
+        }
+
+        if (m_cancel) {
+            m_error = "cancelled";
+            break;
+        }
+
+        while (fed < ready) {
+            const size_t n = std::min<uint64_t>(buf.size(), ready - fed);
+
+            if (pread(m_fd, buf.data(), n, fed) != static_cast<ssize_t>(n)) {
+                m_error = spool + ": " + strerror(errno);
+                break;
+            }
+
+            if (!consume(buf.data(), n)) {
+                m_error = "aborted";
+                break;
+            }
+
+            fed += n;
+        }
+
+        if (!m_error.empty()) break;
+    }
+
+    m_stop = true;
+
+    return fed == end;
+}
+
+} /* namespace */
+
+
+/* returns the offset to resume a spooled download from or 0 */
+static uint64_t resume_offset(const download_job *job, download_state &st)
+{
+    const std::string part = job->spool + ".part";
+    struct stat sb;
+
+    if (!st.load(job->spool + ".state") ||
+        st.url != job->url ||
+        st.etag.empty() ||
+        stat(part.c_str(), &sb) != 0 ||
+        static_cast<uint64_t>(sb.st_size) < st.offset)
+    {
+        return 0;
+    }
+
+    /* anything past the last saved offset may be incomplete */
+    if (truncate(part.c_str(), st.offset) != 0) {
+        return 0;
+    }
+
+    return st.offset;
+}
+
+/* pass the first <len> bytes of <path> to the sink */
+static bool replay(const std::string &path, uint64_t len, download_job *job, hasher *h)
+{
+    FILE *fp = fopen(path.c_str(), "rbe");
+    if (!fp) return false;
+
+    char buf[256*1024];
+
+    while (len > 0) {
+        size_t n = fread(buf, 1, std::min<uint64_t>(len, sizeof(buf)), fp);
+
+        if (n == 0 || !job->sink->write(buf, n)) {
+            fclose(fp);
+            return false;
+        }
+
+        if (h) h->update(buf, n);
+        job->received += n;
+        len -= n;
+    }
+
+    fclose(fp);
+
+    return true;
+}
+
+/* remove cached archives that no index entry refers to anymore */
+static void cache_cleanup(const std::string &dir)
+{
+    std::set<std::string> used;
+    std::vector<std::string> blobs;
+    DIR *dirp = opendir(dir.c_str());
+    struct dirent *d;
+
+    if (!dirp) return;
+
+    while ((d = readdir(dirp)) != NULL) {
+        std::string name = d->d_name;
+        cache_entry ce;
+
+        if (name.size() > 5 && name.compare(name.size() - 5, 5, ".meta") == 0) {
+            if (ce.load(dir + "/" + name)) {
+                used.insert(ce.sha256 + ".tar.gz");
+                used.insert(ce.sha256 + ".pack");
+            }
+        } else if ((name.size() == 64 + 7 && name.compare(64, 7, ".tar.gz") == 0) ||
+                   (name.size() == 64 + 5 && name.compare(64, 5, ".pack") == 0))
+        {
+            blobs.push_back(name);
+        }
+    }
+
+    closedir(dirp);
+
+    for (const auto &name : blobs) {
+        if (used.count(name) == 0) {
+            remove((dir + "/" + name).c_str());
+        }
+    }
+}
+
+/* move a finished spool file into the cache */
+static bool cache_store(const download_job *job, const http_response &res, const std::string &sha256)
+{
+    /* jobs share the cache; without this, one job's cleanup could
+     * remove the archive another job has just stored */
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    cache_entry ce;
+    struct stat st;
+    const std::string part = job->spool + ".part";
+    const std::string blob = job->cache + "/" + sha256 + ".tar.gz";
+    const std::string meta = job->cache + "/" + hasher::string(job->url) + ".meta";
+
+    if (stat(part.c_str(), &st) != 0) {
+        return false;
+    }
+
+    ce.url = job->url;
+    ce.etag = res.header("etag");
+    ce.last_modified = res.header("last-modified");
+    ce.sha256 = sha256;
+    ce.size = st.st_size;
+
+    /* the index entry first, so that the archive is never an orphan */
+    if (!ce.save(meta)) {
+        return false;
+    }
+
+    if (rename(part.c_str(), blob.c_str()) != 0) {
+        remove(meta.c_str());
+        return false;
+    }
+
+    cache_cleanup(job->cache);
+
+    return true;
+}
+
+/* server says our copy is still current: extract it from the cache */
+static bool cache_install(download_job *job, const cache_entry &ce, const std::string &meta)
+{
+    const std::string blob = job->cache + "/" + ce.sha256 + ".tar.gz";
+    const std::string pack = job->cache + "/" + ce.sha256 + ".pack";
+    struct stat st;
+    hasher h;
+
+    /* frames are verified by their own checksums */
+    if (job->sink->takes_pack() && stat(pack.c_str(), &st) == 0) {
+        job->total = st.st_size;
+
+        if (job->sink->extract_pack(pack, job->received, job->error)) {
+            return true;
+        }
+
+        /* anything written so far is replaced by the archive */
+        remove(pack.c_str());
+        job->error.clear();
+        job->received = 0;
+    }
+
+    job->total = ce.size;
+
+    if (!replay(blob, ce.size, job, &h)) {
+        job->error = job->sink->error().empty() ? "cannot read " + blob : job->sink->error();
+        return false;
+    }
+
+    if (h.hex() != ce.sha256) {
+        /* make sure it's downloaded again next time */
+        remove(meta.c_str());
+        remove(blob.c_str());
+        job->error = "cached archive is corrupt: " + blob;
+        return false;
+    }
+
+    return job->sink->finish(job->error);
+}
+
+void download_pool::run_job(download_job *job)
+{
+    TRACE_SCOPE("download", job->name);
+
+    if (m_cancel) {
+        job->error = "cancelled";
+        job->state = DOWNLOAD_FAILED;
+        return;
+    }
+
+    job->state = DOWNLOAD_RUNNING;
+
+    http_response res;
+    std::vector<std::string> headers;
+    download_state st;
+    cache_entry ce;
+    hasher sha;
+    FILE *spool = NULL;
+    uint64_t offset = 0;
+    uint64_t checkpoint = 0;
+    bool started = false;
+    bool can_segment = false;
+    bool segmented = false;
+    bool bad_range = false;
+
+    const bool spooled = !job->spool.empty();
+    const bool cached = spooled && !job->cache.empty();
+    const std::string part = job->spool + ".part";
+    const std::string state = job->spool + ".state";
+    const std::string meta = cached ? job->cache + "/" + hasher::string(job->url) + ".meta" : "";
+
+    if (spooled && (offset = resume_offset(job, st)) > 0) {
+        headers.push_back("Range: bytes=" + std::to_string(offset) + "-");
+        headers.push_back("If-Range: " + st.etag);
+    } else if (cached && ce.load(meta) && ce.url == job->url &&
+               access((job->cache + "/" + ce.sha256 + ".tar.gz").c_str(), R_OK) == 0)
+    {
+        /* revalidate our copy */
+        if (!ce.etag.empty()) headers.push_back("If-None-Match: " + ce.etag);
+        if (!ce.last_modified.empty()) headers.push_back("If-Modified-Since: " + ce.last_modified);
+    }
+
+    auto sink = [&] (const char *buf, size_t len) -> bool {
+        if (m_cancel) return false;
+
+        if (!started) {
+            started = true;
+
+            if (offset > 0 && (res.status != 206 ||
+                res.header("content-range").find("bytes " + std::to_string(offset) + "-") != 0))
+            {
+                /* some other part of the file; don't take it for the whole */
+                if (res.status != 200) {
+                    bad_range = true;
+                    return false;
+                }
+
+                /* the server ignored the range or the file has changed */
+                offset = 0;
+            }
+
+            job->total = (res.content_length < 0) ? -1 : res.content_length + offset;
+            if (!job->sink->begin(res)) return false;
+
+            if (spooled) {
+                if (offset > 0 && !replay(part, offset, job, &sha)) return false;
+
+                spool = fopen(part.c_str(), (offset > 0) ? "abe" : "wbe");
+                if (!spool) return false;
+
+                st.url = job->url;
+                st.etag = res.header("etag");
+                st.offset = checkpoint = offset;
+                st.save(state);
+
+                /* a large file on a server that can send ranges of it:
+                 * fetch the rest over several connections */
+                can_segment = job->segments > 1 && res.content_length >= SEGMENT_MIN_FILE &&
+                    (res.status == 206 || res.header("accept-ranges") == "bytes");
+            }
+        }
+
+        if (spool) {
+            if (fwrite(buf, 1, len, spool) != len) return false;
+            st.offset += len;
+
+            /* checkpoint every few MiB */
+            if (st.offset - checkpoint >= DOWNLOAD_CHECKPOINT) {
+                checkpoint = st.offset;
+                if (fflush(spool) == 0) st.save(state);
+            }
+
+            if (cached) sha.update(buf, len);
+        }
+
+        job->received += len;
+
+        if (!job->sink->write(buf, len)) return false;
+
+        /* the first chunk is used, then the segments take over */
+        segmented = can_segment;
+
+        return !segmented;
+    };
+
+    bool ok = false;
+
+    while (true) {
+        for (size_t i = 0; i < std::max<size_t>(job->sources.size(), 1); i++) {
+            const std::string &url = job->sources.empty() ? job->url : job->sources[i];
+
+            res = http_response();
+            ok = m_client.get(url, headers, res, sink);
+
+            /* once the sink has data, there's no going back */
+            if (started || m_cancel || (ok && res.status < 400)) {
+                break;
+            }
+        }
+
+        if (!bad_range || m_cancel) break;
+
+        /* the server answered with a range we didn't ask for;
+         * nothing was written yet, so start over without one */
+        bad_range = started = false;
+        offset = 0;
+        headers.clear();
+        st = download_state();
+        remove(part.c_str());
+        remove(state.c_str());
+    }
+
+    if (spool) {
+        const bool flushed = (fclose(spool) == 0);
+
+        /* save the state for the next attempt */
+        if (flushed && !ok) st.save(state);
+        if (!flushed) segmented = false;
+    }
+
+    if (segmented && !m_cancel) {
+        segment_fetcher f(m_client, job, res, m_cancel, job->segments);
+
+        auto consume = [&] (const char *buf, size_t len) -> bool {
+            st.offset += len;
+
+            if (st.offset - checkpoint >= DOWNLOAD_CHECKPOINT) {
+                checkpoint = st.offset;
+                st.save(state);
+            }
+
+            if (cached) sha.update(buf, len);
+
+            return job->sink->write(buf, len);
+        };
+
+        ok = f.run(part, st.offset, job->total, consume);
+        res.error = ok ? "" : f.error();
+
+        if (!ok) st.save(state);
+    }
+
+    if (!ok) {
+        if (m_cancel) {
+            job->error = "cancelled";
+        } else if (res.error == "aborted") {
+            job->error = job->sink->error().empty() ? "cannot write data" : job->sink->error();
+        } else {
+            job->error = res.error;
+        }
+        job->state = DOWNLOAD_FAILED;
+        return;
+    }
+
+    if (res.status == 304 && cached) {
+        if (!job->sink->begin(res) || !cache_install(job, ce, meta)) {
+            if (job->error.empty()) job->error = job->sink->error();
+            job->state = DOWNLOAD_FAILED;
+            return;
+        }
+
+        /* only revalidated, so nothing was being resumed */
+        remove(part.c_str());
+        remove(state.c_str());
+
+        job->state = DOWNLOAD_DONE;
+        return;
+    }
+
+    if (cached && started && res.status >= 200 && res.status < 300) {
+        /* hex() finishes the hash, it can only be called once */
+        const std::string digest = sha.hex();
+
+        if (cache_store(job, res, digest) && job->repack) {
+            const std::string blob = job->cache + "/" + digest;
+            std::string err;
+
+            /* only a copy to speed up the next installation */
+            pack_archive(blob + ".tar.gz", blob + ".pack", err);
+        }
+    }
+
+    if (res.status < 200 || res.status > 299) {
+        /* the partial download stays usable for the next attempt */
+        if (spooled && !st.url.empty()) st.save(state);
+
+        job->error = "HTTP error " + std::to_string(res.status) + ": " + res.url;
+        job->state = DOWNLOAD_FAILED;
+        return;
+    }
+
+    /* the whole body was received */
+    if (spooled) {
+        remove(part.c_str());
+        remove(state.c_str());
+    }
+
+    /* empty body */
+    if (!started && !job->sink->begin(res)) {
+        job->error = "cannot write data";
+        job->state = DOWNLOAD_FAILED;
+        return;
+    }
+
+    if (!job->sink->finish(job->error)) {
+        job->state = DOWNLOAD_FAILED;
+        return;
+    }
+
+    job->state = DOWNLOAD_DONE;
+}
@@ -0,0 +1,272 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef DOWNLOAD_HPP
+#define DOWNLOAD_HPP
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "hash.hpp"
+#include "http.hpp"
+#include "untar.hpp"
+
+class download_sink;
+class file_sink;
+class memory_sink;
+class tar_sink;
+struct download_state;
+struct cache_entry;
+struct download_job;
+class download_pool;
+
+
+/* receives the body of a download */
+class download_sink
+{
+protected:
+
+    std::string m_error;
+
+public:
+
+    virtual ~download_sink() {}
+
+    /* reason why begin() or write() failed */
+    const std::string &error() const {return m_error;}
+
+    /* called before the first byte; return false to reject the response */
+    virtual bool begin(const http_response &) {return true;}
+
+    /* return false to abort the download */
+    virtual bool write(const char *buf, size_t len) = 0;
+
+    /* called after the last byte; return false on error */
+    virtual bool finish(std::string &err) = 0;
+
+    /* Instead of the archive, the sink may take a pack of it (see pack.hpp)
+     * that is extracted on all cores; begin() was called, write() and
+     * finish() are not. Packed bytes are added to <progress>. */
+    virtual bool takes_pack() const {return false;}
+    virtual bool extract_pack(const std::string &, std::atomic<uint64_t> &, std::string &err) {
+        err = "not supported";
+        return false;
+    }
+};
+
+/* saves the body to a file; the target is only replaced once the download
+ * was successful and, if given, the git blob hash of <size> bytes matches */
+class file_sink : public download_sink
+{
+private:
+
+    std::string m_path;
+    std::string m_tmp;
+    std::string m_sha1;
+    uint64_t m_size = 0;
+    FILE *m_fp = NULL;
+    hasher *m_hash = NULL;
+
+public:
+
+    file_sink(const std::string &path, const std::string &sha1 = {}, uint64_t size = 0)
+    : m_path(path), m_tmp(path + ".part"), m_sha1(sha1), m_size(size)
+    {}
+
+    virtual ~file_sink();
+
+    bool begin(const http_response &res);
+    bool write(const char *buf, size_t len);
+    bool finish(std::string &err);
+};
+
+/* keeps the body in memory */
+class memory_sink : public download_sink
+{
+private:
+
+    std::string m_data;
+
+public:
+
+    virtual ~memory_sink() {}
+
+    bool write(const char *buf, size_t len) {m_data.append(buf, len); return true;}
+    bool finish(std::string &) {return true;}
+
+    const std::string &data() const {return m_data;}
+};
+
+/* extracts a tar.gz body into <dir> while it's being downloaded;
+ * the extracted files are added to <m> if it's not NULL and if <top>
+ * is set, every member must be inside that directory */
+class tar_sink : public download_sink
+{
+private:
+
+    tar_extractor m_tar;
+    std::string m_dir;
+    std::string m_top;
+    manifest *m_manifest;
+
+public:
+
+    tar_sink(const std::string &dir, manifest *m = NULL, const std::string &top = std::string())
+    : m_tar(dir), m_dir(dir), m_top(top), m_manifest(m)
+    {
+        m_tar.record(m);
+        m_tar.top(top);
+    }
+
+    virtual ~tar_sink() {}
+
+    bool write(const char *buf, size_t len);
+    bool finish(std::string &err);
+
+    bool takes_pack() const {return true;}
+    bool extract_pack(const std::string &path, std::atomic<uint64_t> &progress, std::string &err);
+};
+
+
+/* progress of an interrupted download, saved as "<spool>.state" */
+struct download_state
+{
+    std::string url;
+    std::string etag;
+    uint64_t offset = 0;
+
+    bool load(const std::string &path);
+    bool save(const std::string &path) const;
+};
+
+/* index entry of a cached archive, saved as "<cache>/<sha256(url)>.meta";
+ * the archive itself is stored as "<cache>/<sha256>.tar.gz" and, if it
+ * was repacked, as "<cache>/<sha256>.pack" */
+struct cache_entry
+{
+    std::string url;
+    std::string etag;
+    std::string last_modified;
+    std::string sha256;
+    uint64_t size = 0;
+
+    bool load(const std::string &path);
+    bool save(const std::string &path) const;
+};
+
+enum {
+    DOWNLOAD_QUEUED,
+    DOWNLOAD_RUNNING,
+    DOWNLOAD_DONE,
+    DOWNLOAD_FAILED
+};
+
+/* a single file to download; progress can be read from any thread */
+struct download_job
+{
+    std::string name;
+    std::string url;
+    download_sink *sink = NULL;
+
+    /* if set, the file is downloaded from these URLs instead, trying
+     * the next one if a server fails before sending any data; <url>
+     * still identifies the file in the spool and cache */
+    std::vector<std::string> sources;
+
+    /* a failed optional download doesn't fail the whole pool */
+    bool optional = false;
+
+    /* if set, the raw body is also kept in "<spool>.part" so that
+     * an interrupted download can be resumed with a Range request */
+    std::string spool;
+
+    /* if set (requires spool), finished archives are kept in this
+     * directory and revalidated with a conditional GET next time */
+    std::string cache;
+
+    /* if larger than 1 (requires spool), a large file is fetched over up
+     * to this many connections at once if the server supports ranges */
+    int segments = 1;
+
+    /* if set (requires cache), cached archives are also repacked for
+     * parallel extraction; an existing pack is always used */
+    bool repack = false;
+
+    std::atomic<int> state {DOWNLOAD_QUEUED};
+    std::atomic<uint64_t> received {0};
+    std::atomic<int64_t> total {-1};
+
+    /* only valid once state is DOWNLOAD_FAILED */
+    std::string error;
+
+    download_job(const std::string &n, const std::string &u, download_sink *s, bool opt = false)
+    : name(n), url(u), sink(s), optional(opt)
+    {}
+};
+
+/* runs all added jobs at the same time on a small number of
+ * worker threads that share one connection pool */
+class download_pool
+{
+private:
+
+    http_client m_client;
+    std::vector<download_job *> m_jobs;
+    std::vector<std::thread> m_threads;
+    std::atomic<size_t> m_next {0};
+    std::atomic<size_t> m_finished {0};
+    std::atomic<bool> m_cancel {false};
+    int m_workers = 4;
+
+    void worker();
+    void run_job(download_job *job);
+
+public:
+
+    download_pool(int workers = 4)
+    : m_workers(workers)
+    {}
+
+    ~download_pool();
+
+    /* jobs must be added before start() and outlive the pool */
+    void add(download_job *job) {m_jobs.push_back(job);}
+    const std::vector<download_job *> &jobs() const {return m_jobs;}
+
+    void start();
+    void wait();
+    void cancel() {m_cancel = true;}
+
+    bool cancelled() const {return m_cancel;}
+    bool done() const {return m_finished == m_jobs.size();}
+
+    /* true if all jobs that are not optional were successful */
+    bool success() const;
+};
+
+#endif /* DOWNLOAD_HPP */
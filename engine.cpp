@@ -0,0 +1,153 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <string>
+#include <ctype.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "engine.hpp"
+#include "keyfile.hpp"
+
+
+bool engine_info::stamp::read(const std::string &path)
+{
+    struct stat st;
+
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+
+    dev = st.st_dev;
+    ino = st.st_ino;
+    size = st.st_size;
+    mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+
+    return true;
+}
+
+bool engine_info::load(const std::string &path)
+{
+    keyfile kf;
+
+    if (!kf.load(path) || kf.get("name") != m_name) {
+        return false;
+    }
+
+    m_path = kf.get("path");
+    m_version = kf.get("version");
+    m_search = kf.get("search");
+    m_stamp.dev = kf.get_u64("dev");
+    m_stamp.ino = kf.get_u64("ino");
+    m_stamp.size = kf.get_u64("size");
+    m_stamp.mtime = kf.get_u64("mtime");
+
+    return true;
+}
+
+bool engine_info::save(const std::string &path) const
+{
+    keyfile kf;
+
+    kf.set("name", m_name);
+    kf.set("path", m_path);
+    kf.set("version", m_version);
+    kf.set("search", m_search);
+    kf.set("dev", m_stamp.dev);
+    kf.set("ino", m_stamp.ino);
+    kf.set("size", m_stamp.size);
+    kf.set("mtime", static_cast<uint64_t>(m_stamp.mtime));
+
+    return kf.save(path);
+}
+
+bool engine_info::valid() const
+{
+    const char *env = getenv("PATH");
+    stamp st;
+
+    /* a different $PATH may find a different binary first */
+    if (m_path.empty() || m_search != (env ? env : "")) {
+        return false;
+    }
+
+    return (st.read(m_path) && st == m_stamp && access(m_path.c_str(), X_OK) == 0);
+}
+
+bool engine_info::resolve()
+{
+    const char *env = getenv("PATH");
+    std::string search = env ? env : "/usr/local/bin:/usr/bin:/bin";
+    const stamp old = m_stamp;
+
+    m_path.clear();
+    m_search = env ? env : "";
+    m_stamp = stamp();
+
+    for (size_t p = 0, end; p <= search.size(); p = end + 1) {
+        end = search.find(':', p);
+        if (end == std::string::npos) end = search.size();
+
+        /* an empty entry means the current directory */
+        std::string dir = search.substr(p, end - p);
+        if (dir.empty()) dir = ".";
+
+        std::string path = dir + "/" + m_name;
+
+        if (m_stamp.read(path) && access(path.c_str(), X_OK) == 0) {
+            if (path[0] == '/') {
+                m_path = path;
+                break;
+            }
+
+            /* relative $PATH entry */
+            char *abs = realpath(path.c_str(), NULL);
+
+            if (abs) {
+                m_path = abs;
+                free(abs);
+                break;
+            }
+        }
+
+        m_stamp = stamp();
+    }
+
+    if (m_path.empty() || !(m_stamp == old)) {
+        m_version.clear();
+    }
+
+    return !m_path.empty();
+}
+
+void engine_info::version(const std::string &output)
+{
+    size_t len = output.find('\n');
+    m_version = output.substr(0, len);
+
+    while (!m_version.empty() && isspace(static_cast<unsigned char>(m_version.back()))) {
+        m_version.pop_back();
+    }
+}
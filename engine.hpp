@@ -0,0 +1,85 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef ENGINE_HPP
+#define ENGINE_HPP
+
+#include <string>
+#include <stdint.h>
+
+class engine_info;
+
+
+/* Absolute path and "--version" output of the game engine executable.
+ * Both are kept in a small cache file and are only looked up again when
+ * $PATH changes or the binary was replaced (device, inode, size, mtime). */
+class engine_info
+{
+private:
+
+    struct stamp
+    {
+        uint64_t dev = 0;
+        uint64_t ino = 0;
+        uint64_t size = 0;
+        int64_t mtime = 0;  /* nanoseconds */
+
+        bool read(const std::string &path);
+
+        bool operator==(const stamp &o) const {
+            return dev == o.dev && ino == o.ino && size == o.size && mtime == o.mtime;
+        }
+    };
+
+    std::string m_name;
+    std::string m_path;
+    std::string m_version;
+    std::string m_search;  /* $PATH the executable was found with */
+    stamp m_stamp;
+
+public:
+
+    engine_info(const char *name = "alephone")
+    : m_name(name)
+    {}
+
+    bool load(const std::string &path);
+    bool save(const std::string &path) const;
+
+    /* true if $PATH didn't change and the cached path still
+     * points to the same executable; otherwise call resolve() */
+    bool valid() const;
+
+    /* scan $PATH for the executable; the version is kept if it's
+     * still the same file, returns false if it wasn't found */
+    bool resolve();
+
+    const std::string &path() const {return m_path;}
+    const std::string &version() const {return m_version;}
+
+    /* set from the first line of "<path> --version" */
+    void version(const std::string &output);
+};
+
+#endif /* ENGINE_HPP */
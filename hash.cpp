@@ -0,0 +1,94 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <openssl/evp.h>
+#include <string>
+#include <stdio.h>
+
+#include "hash.hpp"
+
+
+hasher::hasher(algorithm a)
+{
+    m_ctx = EVP_MD_CTX_new();
+    EVP_DigestInit_ex(m_ctx, (a == SHA1) ? EVP_sha1() : EVP_sha256(), NULL);
+}
+
+hasher::~hasher()
+{
+    EVP_MD_CTX_free(m_ctx);
+}
+
+void hasher::update(const void *buf, size_t len)
+{
+    EVP_DigestUpdate(m_ctx, buf, len);
+}
+
+std::string hasher::hex()
+{
+    unsigned char md[EVP_MAX_MD_SIZE];
+    unsigned int len = 0;
+    char buf[EVP_MAX_MD_SIZE*2 + 1];
+
+    EVP_DigestFinal_ex(m_ctx, md, &len);
+
+    for (unsigned int i = 0; i < len; i++) {
+        sprintf(buf + i*2, "%02x", md[i]);
+    }
+
+    return std::string(buf, len*2);
+}
+
+std::string hasher::file(const std::string &path, algorithm a)
+{
+    FILE *fp = fopen(path.c_str(), "rbe");
+    if (!fp) return {};
+
+    hasher h(a);
+    char buf[256*1024];
+    size_t n;
+
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        h.update(buf, n);
+    }
+
+    bool err = ferror(fp);
+    fclose(fp);
+
+    return err ? std::string() : h.hex();
+}
+
+std::string hasher::string(const std::string &s, algorithm a)
+{
+    hasher h(a);
+    h.update(s.data(), s.size());
+    return h.hex();
+}
+
+void git_blob_header(hasher &h, uint64_t size)
+{
+    char buf[32];
+    int n = snprintf(buf, sizeof(buf), "blob %llu", static_cast<unsigned long long>(size));
+    h.update(buf, n + 1);  /* including the terminating null byte */
+}
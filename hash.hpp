@@ -0,0 +1,70 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef HASH_HPP
+#define HASH_HPP
+
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct evp_md_ctx_st EVP_MD_CTX;
+
+
+/* incremental SHA-1/SHA-256 with hex output */
+class hasher
+{
+public:
+
+    enum algorithm {
+        SHA1,
+        SHA256
+    };
+
+private:
+
+    EVP_MD_CTX *m_ctx = NULL;
+
+public:
+
+    hasher(algorithm a = SHA256);
+    ~hasher();
+
+    void update(const void *buf, size_t len);
+
+    /* finish and return the digest as lowercase hex */
+    std::string hex();
+
+    /* hash a whole file; returns an empty string on error */
+    static std::string file(const std::string &path, algorithm a = SHA256);
+
+    /* hash a string */
+    static std::string string(const std::string &s, algorithm a = SHA256);
+};
+
+/* start a git blob hash ("blob <size>\0"); the result of hashing
+ * the file content afterwards is the same as "git hash-object" */
+void git_blob_header(hasher &h, uint64_t size);
+
+#endif /* HASH_HPP */
@@ -0,0 +1,543 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <algorithm>
+#include <string>
+#include <errno.h>
+#include <netdb.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "http.hpp"
+
+#define HTTP_MAX_REDIRECTS  8
+#define HTTP_USER_AGENT     "marathon-game-launcher"
+
+
+static SSL_CTX *tls_context()
+{
+    static std::once_flag flag;
+    static SSL_CTX *ctx = NULL;
+
+    std::call_once(flag, [] () {
+        ctx = SSL_CTX_new(TLS_client_method());
+
+        if (ctx) {
+            SSL_CTX_set_default_verify_paths(ctx);
+            SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, NULL);
+            SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+        }
+    });
+
+    return ctx;
+}
+
+void http_block_sigpipe()
+{
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+}
+
+static std::string lowercase(std::string s)
+{
+    std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+    return s;
+}
+
+/* resolve a redirect target against the current URL */
+static std::string resolve_location(const http_url &u, const std::string &loc)
+{
+    if (loc.find("://") != std::string::npos) {
+        return loc;
+    } else if (loc.compare(0, 2, "//") == 0) {
+        return u.scheme + ":" + loc;
+    } else if (loc[0] == '/') {
+        return u.scheme + "://" + u.authority() + loc;
+    }
+
+    std::string dir = u.path.substr(0, u.path.rfind('/') + 1);
+    return u.scheme + "://" + u.authority() + dir + loc;
+}
+
+
+bool http_url::parse(const std::string &url)
+{
+    size_t p = url.find("://");
+    if (p == std::string::npos) return false;
+
+    scheme = lowercase(url.substr(0, p));
+    if (scheme != "http" && scheme != "https") return false;
+
+    std::string rest = url.substr(p + 3);
+    size_t slash = rest.find('/');
+
+    std::string hostport = rest.substr(0, slash);
+    path = (slash == std::string::npos) ? "/" : rest.substr(slash);
+
+    size_t colon = hostport.rfind(':');
+
+    if (colon != std::string::npos && hostport.find(']', colon) == std::string::npos) {
+        host = hostport.substr(0, colon);
+        port = hostport.substr(colon + 1);
+    } else {
+        host = hostport;
+        port = tls() ? "443" : "80";
+    }
+
+    /* IPv6 literal */
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+
+    return !host.empty() && !port.empty();
+}
+
+std::string http_response::header(const char *name) const
+{
+    auto it = headers.find(name);
+    return (it == headers.end()) ? std::string() : it->second;
+}
+
+
+http_connection::~http_connection()
+{
+    if (m_ssl) {
+        SSL_shutdown(m_ssl);
+        SSL_free(m_ssl);
+    }
+
+    if (m_fd != -1) close(m_fd);
+}
+
+bool http_connection::connect(const http_url &u, int timeout, std::string &err)
+{
+    struct addrinfo hints, *res = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    int rv = getaddrinfo(u.host.c_str(), u.port.c_str(), &hints, &res);
+
+    if (rv != 0) {
+        err = u.host + ": " + gai_strerror(rv);
+        return false;
+    }
+
+    struct timeval tv;
+    tv.tv_sec = timeout;
+    tv.tv_usec = 0;
+
+    for (struct addrinfo *ai = res; ai; ai = ai->ai_next) {
+        m_fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (m_fd == -1) continue;
+
+        setsockopt(m_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(m_fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+        if (::connect(m_fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+
+        close(m_fd);
+        m_fd = -1;
+    }
+
+    freeaddrinfo(res);
+
+    if (m_fd == -1) {
+        err = u.host + ": " + strerror(errno);
+        return false;
+    }
+
+    if (u.tls()) {
+        SSL_CTX *ctx = tls_context();
+
+        if (!ctx || (m_ssl = SSL_new(ctx)) == NULL) {
+            err = "cannot initialize TLS";
+            return false;
+        }
+
+        SSL_set_fd(m_ssl, m_fd);
+        SSL_set_tlsext_host_name(m_ssl, u.host.c_str());
+        SSL_set1_host(m_ssl, u.host.c_str());
+
+        if (SSL_connect(m_ssl) != 1) {
+            char buf[256];
+            ERR_error_string_n(ERR_get_error(), buf, sizeof(buf));
+            err = u.host + ": " + buf;
+            return false;
+        }
+    }
+
+    m_key = u.key();
+
+    return true;
+}
+
+bool http_connection::write_all(const std::string &s)
+{
+    const char *p = s.data();
+    size_t left = s.size();
+
+    while (left > 0) {
+        ssize_t n;
+
+        if (m_ssl) {
+            n = SSL_write(m_ssl, p, left);
+        } else {
+            n = send(m_fd, p, left, MSG_NOSIGNAL);
+            if (n == -1 && errno == EINTR) continue;
+        }
+
+        if (n <= 0) return false;
+
+        p += n;
+        left -= n;
+    }
+
+    return true;
+}
+
+ssize_t http_connection::fill()
+{
+    ssize_t n;
+
+    do {
+        n = m_ssl ? SSL_read(m_ssl, m_buf, sizeof(m_buf))
+                  : recv(m_fd, m_buf, sizeof(m_buf), 0);
+    } while (!m_ssl && n == -1 && errno == EINTR);
+
+    m_pos = 0;
+    m_len = (n > 0) ? n : 0;
+
+    return n;
+}
+
+ssize_t http_connection::read_some(char *buf, size_t len)
+{
+    if (m_pos == m_len) {
+        ssize_t n = fill();
+        if (n <= 0) return n;
+    }
+
+    size_t n = std::min(len, m_len - m_pos);
+    memcpy(buf, m_buf + m_pos, n);
+    m_pos += n;
+
+    return n;
+}
+
+bool http_connection::read_line(std::string &line)
+{
+    line.clear();
+
+    while (true) {
+        if (m_pos == m_len && fill() <= 0) {
+            return false;
+        }
+
+        char *p = m_buf + m_pos;
+        char *nl = reinterpret_cast<char *>(memchr(p, '\n', m_len - m_pos));
+
+        if (nl) {
+            line.append(p, nl - p);
+            m_pos += (nl - p) + 1;
+            break;
+        }
+
+        line.append(p, m_len - m_pos);
+        m_pos = m_len;
+
+        /* header line is too long */
+        if (line.size() > 64*1024) return false;
+    }
+
+    if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+    }
+
+    return true;
+}
+
+
+http_client::~http_client()
+{
+    for (auto &e : m_idle) {
+        delete e.second;
+    }
+}
+
+http_connection *http_client::acquire(const http_url &u, std::string &err)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_idle.find(u.key());
+
+        if (it != m_idle.end()) {
+            http_connection *c = it->second;
+            m_idle.erase(it);
+            c->reused(true);
+            return c;
+        }
+    }
+
+    http_connection *c = new http_connection;
+
+    if (!c->connect(u, m_timeout, err)) {
+        delete c;
+        return NULL;
+    }
+
+    return c;
+}
+
+void http_client::release(http_connection *c, bool keep_alive)
+{
+    if (!keep_alive) {
+        delete c;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_idle.insert(std::make_pair(c->key(), c));
+}
+
+/* returns 1 on success, 0 on error and -1 if a stale
+ * keep-alive connection should be retried */
+int http_client::request_once(const char *method, const http_url &u,
+                              const std::vector<std::string> &headers,
+                              http_response &res, const http_sink &sink)
+{
+    http_connection *c = acquire(u, res.error);
+    if (!c) return 0;
+
+    const bool reused = c->reused();
+    std::string s = std::string(method) + " " + u.path + " HTTP/1.1\r\n"
+        "Host: " + u.authority() + "\r\n"
+        "User-Agent: " HTTP_USER_AGENT "\r\n"
+        "Accept: */*\r\n";
+
+    for (const auto &h : headers) {
+        s += h + "\r\n";
+    }
+    s += "\r\n";
+
+    std::string line;
+
+    if (!c->write_all(s) || !c->read_line(line)) {
+        delete c;
+        if (reused) return -1;
+        res.error = u.host + ": connection closed";
+        return 0;
+    }
+
+    /* status line: "HTTP/1.1 200 OK" */
+    if (line.compare(0, 5, "HTTP/") != 0 || line.size() < 12) {
+        delete c;
+        res.error = u.host + ": invalid response";
+        return 0;
+    }
+
+    bool keep_alive = (line.compare(0, 8, "HTTP/1.0") != 0);
+    res.status = atoi(line.c_str() + 9);
+    res.content_length = -1;
+    res.headers.clear();
+
+    while (true) {
+        if (!c->read_line(line)) {
+            delete c;
+            res.error = u.host + ": connection closed";
+            return 0;
+        }
+
+        if (line.empty()) break;
+
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+
+        std::string name = lowercase(line.substr(0, colon));
+        size_t v = line.find_first_not_of(" \t", colon + 1);
+        res.headers[name] = (v == std::string::npos) ? "" : line.substr(v);
+    }
+
+    std::string conn = lowercase(res.header("connection"));
+    if (conn == "close") keep_alive = false;
+    if (conn == "keep-alive") keep_alive = true;
+
+    std::string len = res.header("content-length");
+    if (!len.empty()) res.content_length = strtoll(len.c_str(), NULL, 10);
+
+    /* forward the body only if it's what the caller asked for */
+    const bool deliver = (res.status >= 200 && res.status < 300);
+    const bool chunked = (lowercase(res.header("transfer-encoding")).find("chunked") != std::string::npos);
+    char buf[64*1024];
+
+    if (strcmp(method, "HEAD") == 0 || res.status == 204 || res.status == 304 ||
+        (res.status >= 100 && res.status < 200))
+    {
+        /* no body */
+    }
+    else if (chunked) {
+        while (true) {
+            if (!c->read_line(line)) {
+                delete c;
+                res.error = u.host + ": connection closed";
+                return 0;
+            }
+
+            /* "<hex size>[;extensions]" */
+            char *end;
+            int64_t left = strtoll(line.c_str(), &end, 16);
+
+            if (end == line.c_str() || left < 0 || (*end && *end != ';' && *end != ' ' && *end != '\t')) {
+                delete c;
+                res.error = u.host + ": invalid chunk size";
+                return 0;
+            }
+
+            if (left == 0) {
+                /* skip trailers */
+                while (c->read_line(line) && !line.empty()) {}
+                break;
+            }
+
+            while (left > 0) {
+                ssize_t n = c->read_some(buf, std::min<int64_t>(left, sizeof(buf)));
+
+                if (n <= 0) {
+                    delete c;
+                    res.error = u.host + ": connection closed";
+                    return 0;
+                }
+
+                if (deliver && !sink(buf, n)) {
+                    delete c;
+                    res.error = "aborted";
+                    return 0;
+                }
+
+                left -= n;
+            }
+
+            /* CRLF after chunk data */
+            if (!c->read_line(line) || !line.empty()) {
+                delete c;
+                res.error = u.host + ": invalid chunked encoding";
+                return 0;
+            }
+        }
+    }
+    else if (res.content_length >= 0) {
+        int64_t left = res.content_length;
+
+        while (left > 0) {
+            ssize_t n = c->read_some(buf, std::min<int64_t>(left, sizeof(buf)));
+
+            if (n <= 0) {
+                delete c;
+                res.error = u.host + ": connection closed";
+                return 0;
+            }
+
+            if (deliver && !sink(buf, n)) {
+                delete c;
+                res.error = "aborted";
+                return 0;
+            }
+
+            left -= n;
+        }
+    }
+    else {
+        /* read until the server closes the connection */
+        ssize_t n;
+
+        while ((n = c->read_some(buf, sizeof(buf))) > 0) {
+            if (deliver && !sink(buf, n)) {
+                delete c;
+                res.error = "aborted";
+                return 0;
+            }
+        }
+
+        keep_alive = false;
+    }
+
+    release(c, keep_alive);
+
+    return 1;
+}
+
+bool http_client::request(const char *method, const std::string &url,
+                          const std::vector<std::string> &headers,
+                          http_response &res, const http_sink &sink)
+{
+    std::string current = url;
+
+    for (int i = 0; i <= HTTP_MAX_REDIRECTS; i++) {
+        http_url u;
+
+        if (!u.parse(current)) {
+            res.error = "invalid URL: " + current;
+            return false;
+        }
+
+        res.url = current;
+        int rv = request_once(method, u, headers, res, sink);
+
+        /* stale keep-alive connection, try once more */
+        if (rv == -1) {
+            rv = request_once(method, u, headers, res, sink);
+            if (rv == -1) res.error = u.host + ": connection closed";
+        }
+
+        if (rv != 1) return false;
+
+        switch (res.status) {
+            case 301: case 302: case 303: case 307: case 308:
+                if (res.header("location").empty()) return true;
+                current = resolve_location(u, res.header("location"));
+
+                /* never fall back from https to plain http */
+                if (u.tls() && lowercase(current.substr(0, 8)) != "https://") {
+                    res.error = "refused redirect from https to " + current;
+                    return false;
+                }
+                break;
+            default:
+                return true;
+        }
+    }
+
+    res.error = "too many redirects";
+
+    return false;
+}
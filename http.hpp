@@ -0,0 +1,158 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef HTTP_HPP
+#define HTTP_HPP
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef struct ssl_st SSL;
+
+
+/* URL split into its parts: scheme://host[:port]/path */
+struct http_url
+{
+    std::string scheme;
+    std::string host;
+    std::string port;
+    std::string path;
+
+    bool parse(const std::string &url);
+    bool tls() const {return scheme == "https";}
+
+    /* host with brackets if it's an IPv6 literal */
+    std::string host_literal() const {
+        return (host.find(':') != std::string::npos) ? "[" + host + "]" : host;
+    }
+
+    /* "host[:port]" for the Host header and URLs; the port is
+     * left out if it's the default one of the scheme */
+    std::string authority() const {
+        return (port == (tls() ? "443" : "80")) ? host_literal() : host_literal() + ":" + port;
+    }
+
+    /* connections can be reused between URLs with the same key */
+    std::string key() const {return scheme + "://" + host_literal() + ":" + port;}
+};
+
+/* status line and headers of the final response (after redirects) */
+struct http_response
+{
+    int status = 0;
+    int64_t content_length = -1;
+    std::map<std::string, std::string> headers;  /* lowercase names */
+    std::string url;
+    std::string error;
+
+    /* returns an empty string if the header was not sent */
+    std::string header(const char *name) const;
+};
+
+/* receives the response body in chunks; the response headers are
+ * already filled in on the first call; return false to abort */
+typedef std::function<bool (const char *buf, size_t len)> http_sink;
+
+
+/* a single (TLS) connection that can be kept alive */
+class http_connection
+{
+private:
+
+    int m_fd = -1;
+    SSL *m_ssl = NULL;
+    std::string m_key;
+    bool m_reused = false;
+
+    /* read buffer */
+    char m_buf[64*1024];
+    size_t m_pos = 0;
+    size_t m_len = 0;
+
+    ssize_t fill();
+
+public:
+
+    http_connection() {}
+    ~http_connection();
+
+    bool connect(const http_url &u, int timeout, std::string &err);
+
+    const std::string &key() const {return m_key;}
+    bool reused() const {return m_reused;}
+    void reused(bool b) {m_reused = b;}
+
+    bool write_all(const std::string &s);
+    ssize_t read_some(char *buf, size_t len);
+    bool read_line(std::string &line);
+};
+
+/* minimal HTTP/1.1 client with a keep-alive connection pool;
+ * a single instance can be shared between threads */
+class http_client
+{
+private:
+
+    std::mutex m_mutex;
+    std::multimap<std::string, http_connection *> m_idle;
+    int m_timeout = 30;
+
+    http_connection *acquire(const http_url &u, std::string &err);
+    void release(http_connection *c, bool keep_alive);
+
+    int request_once(const char *method, const http_url &u,
+                     const std::vector<std::string> &headers,
+                     http_response &res, const http_sink &sink);
+
+public:
+
+    http_client() {}
+    ~http_client();
+
+    void timeout(int seconds) {m_timeout = seconds;}
+
+    /* Send a request and follow redirects. The sink only receives the body
+     * of a 2xx response. Returns false on network errors or if the sink
+     * aborted the transfer; HTTP errors are reported in res.status. */
+    bool request(const char *method, const std::string &url,
+                 const std::vector<std::string> &headers,
+                 http_response &res, const http_sink &sink);
+
+    bool get(const std::string &url, const std::vector<std::string> &headers,
+             http_response &res, const http_sink &sink)
+    {
+        return request("GET", url, headers, res, sink);
+    }
+};
+
+/* block SIGPIPE in the calling thread so that writing to a closed
+ * connection fails with EPIPE; call this in every worker thread */
+void http_block_sigpipe();
+
+#endif /* HTTP_HPP */
@@ -0,0 +1,183 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <FL/Fl_PNG_Image.H>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "icon.hpp"
+#include "keyfile.hpp"
+#include "trace.hpp"
+
+static const unsigned char png_signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+
+/* cheap check before handing a file to libpng */
+static bool is_png(const std::string &path)
+{
+    unsigned char buf[sizeof(png_signature)];
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return false;
+
+    const ssize_t len = read(fd, buf, sizeof(buf));
+    close(fd);
+
+    return (len == sizeof(buf) && memcmp(buf, png_signature, sizeof(buf)) == 0);
+}
+
+static int64_t mtime_ns(const struct stat &st)
+{
+    return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+
+icon_loader::~icon_loader()
+{
+    if (m_thread.joinable()) m_thread.join();
+    if (m_image) delete m_image;
+    if (m_pipe[0] != -1) close(m_pipe[0]);
+    if (m_pipe[1] != -1) close(m_pipe[1]);
+}
+
+bool icon_loader::start(const std::vector<std::string> &candidates, const std::string &cachefile)
+{
+    /* the previous result is no longer wanted */
+    if (m_thread.joinable()) {
+        delete finish();
+    }
+
+    if (m_pipe[0] == -1 && pipe2(m_pipe, O_NONBLOCK | O_CLOEXEC) == -1) {
+        return false;
+    }
+
+    m_candidates = candidates;
+    m_cachefile = cachefile;
+    m_path.clear();
+
+    m_thread = std::thread(&icon_loader::worker, this);
+
+    return true;
+}
+
+Fl_PNG_Image *icon_loader::finish()
+{
+    char buf[16];
+
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+
+    while (read(m_pipe[0], buf, sizeof(buf)) > 0) {}
+
+    Fl_PNG_Image *img = m_image;
+    m_image = NULL;
+
+    return img;
+}
+
+/* the cached winner can be used if it didn't change and no
+ * candidate with a higher preference showed up since */
+bool icon_loader::cached(std::string &path) const
+{
+    keyfile kf;
+    struct stat st;
+
+    if (!kf.load(m_cachefile) || !kf.has("path")) {
+        return false;
+    }
+
+    path = kf.get("path");
+
+    for (const auto &s : m_candidates) {
+        if (s == path) {
+            return (stat(s.c_str(), &st) == 0 &&
+                    static_cast<uint64_t>(st.st_size) == kf.get_u64("size") &&
+                    static_cast<uint64_t>(mtime_ns(st)) == kf.get_u64("mtime"));
+        }
+
+        if (stat(s.c_str(), &st) == 0) {
+            return false;
+        }
+    }
+
+    /* none was found last time */
+    return path.empty();
+}
+
+Fl_PNG_Image *icon_loader::decode(const std::string &path)
+{
+    TRACE_SCOPE("icon decode", path);
+    Fl_PNG_Image *img = new Fl_PNG_Image(path.c_str());
+
+    if (img->fail()) {
+        delete img;
+        return NULL;
+    }
+
+    return img;
+}
+
+void icon_loader::worker()
+{
+    TRACE_SCOPE("icon lookup");
+    std::string path;
+
+    /* an empty path means that there's no icon file */
+    if (cached(path) && (path.empty() || (m_image = decode(path)) != NULL)) {
+        m_path = path;
+    } else {
+        path.clear();
+
+        for (const auto &s : m_candidates) {
+            TRACE_SCOPE("icon probe", s);
+
+            if (is_png(s) && (m_image = decode(s)) != NULL) {
+                path = s;
+                break;
+            }
+        }
+
+        /* remember the winner */
+        keyfile kf;
+        struct stat st;
+
+        kf.set("path", path);
+
+        if (!path.empty() && stat(path.c_str(), &st) == 0) {
+            kf.set("size", static_cast<uint64_t>(st.st_size));
+            kf.set("mtime", static_cast<uint64_t>(mtime_ns(st)));
+        }
+
+        kf.save(m_cachefile);
+        m_path = path;
+    }
+
+    if (write(m_pipe[1], "", 1) == -1) {}
+}
@@ -0,0 +1,76 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef ICON_HPP
+#define ICON_HPP
+
+#include <string>
+#include <thread>
+#include <vector>
+
+class Fl_PNG_Image;
+class icon_loader;
+
+
+/* Finds and decodes the window icon on a background thread. Candidates
+ * are only checked for existence and the PNG signature before anything
+ * is decoded, and the winner is remembered in a cache file by size and
+ * mtime, so that usually exactly one file is read. */
+class icon_loader
+{
+private:
+
+    std::thread m_thread;
+    int m_pipe[2] = { -1, -1 };
+
+    std::vector<std::string> m_candidates;
+    std::string m_cachefile;
+
+    Fl_PNG_Image *m_image = NULL;
+    std::string m_path;
+
+    void worker();
+    bool cached(std::string &path) const;
+    Fl_PNG_Image *decode(const std::string &path);
+
+public:
+
+    icon_loader() {}
+    ~icon_loader();
+
+    /* <candidates> in order of preference */
+    bool start(const std::vector<std::string> &candidates, const std::string &cachefile);
+
+    /* becomes readable once the icon was loaded */
+    int fd() const {return m_pipe[0];}
+
+    /* wait for the thread; the caller owns the returned image, which
+     * is NULL if none of the candidates could be decoded */
+    Fl_PNG_Image *finish();
+
+    /* the file the icon was loaded from */
+    const std::string &path() const {return m_path;}
+};
+
+#endif /* ICON_HPP */
@@ -0,0 +1,149 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+/* build tool: decodes a PNG file and writes its RGBA pixels, scaled
+ * down to several sizes, as a C header to stdout; this way the
+ * embedded fallback icon doesn't need to be decoded at runtime
+ *
+ * usage: icongen <file.png> <name> <size> [<size> ...]
+ */
+
+#include <algorithm>
+#include <vector>
+#include <png.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* area-weighted box filter on premultiplied alpha */
+static std::vector<unsigned char> scale(const std::vector<unsigned char> &src, int sw, int sh, int dw, int dh)
+{
+    std::vector<unsigned char> dst(dw * dh * 4);
+    const double fx = static_cast<double>(sw) / dw;
+    const double fy = static_cast<double>(sh) / dh;
+
+    for (int y = 0; y < dh; y++) {
+        for (int x = 0; x < dw; x++) {
+            double acc[4] = { 0, 0, 0, 0 };
+            double area = 0;
+
+            for (int sy = static_cast<int>(y * fy); sy < sh && sy < (y + 1) * fy; sy++) {
+                double wy = std::min<double>(sy + 1, (y + 1) * fy) - std::max<double>(sy, y * fy);
+
+                for (int sx = static_cast<int>(x * fx); sx < sw && sx < (x + 1) * fx; sx++) {
+                    double wx = std::min<double>(sx + 1, (x + 1) * fx) - std::max<double>(sx, x * fx);
+                    const unsigned char *p = &src[(sy * sw + sx) * 4];
+                    const double w = wx * wy;
+                    const double a = p[3] / 255.0;
+
+                    acc[0] += p[0] * a * w;
+                    acc[1] += p[1] * a * w;
+                    acc[2] += p[2] * a * w;
+                    acc[3] += p[3] * w;
+                    area += w;
+                }
+            }
+
+            unsigned char *q = &dst[(y * dw + x) * 4];
+            const double a = acc[3] / area;
+
+            for (int i = 0; i < 3; i++) {
+                q[i] = (a > 0) ? static_cast<unsigned char>(std::min(255.0, acc[i] / area / (a / 255.0) + 0.5)) : 0;
+            }
+
+            q[3] = static_cast<unsigned char>(a + 0.5);
+        }
+    }
+
+    return dst;
+}
+
+static void print_array(const char *name, int size, const std::vector<unsigned char> &data)
+{
+    printf("const unsigned char %s_%d[] = {", name, size);
+
+    for (size_t i = 0; i < data.size(); i++) {
+        printf("%s0x%02x,", (i % 12 == 0) ? "\n  " : " ", data[i]);
+    }
+
+    printf("\n};\n\n");
+}
+
+int main(int argc, char **argv)
+{
+    png_image img;
+    std::vector<int> sizes;
+
+    if (argc < 4) {
+        fprintf(stderr, "usage: %s <file.png> <name> <size> [<size> ...]\n", argv[0]);
+        return 1;
+    }
+
+    memset(&img, 0, sizeof(img));
+    img.version = PNG_IMAGE_VERSION;
+
+    if (!png_image_begin_read_from_file(&img, argv[1])) {
+        fprintf(stderr, "%s: %s\n", argv[1], img.message);
+        return 1;
+    }
+
+    img.format = PNG_FORMAT_RGBA;
+    std::vector<unsigned char> pixels(PNG_IMAGE_SIZE(img));
+
+    if (!png_image_finish_read(&img, NULL, pixels.data(), 0, NULL)) {
+        fprintf(stderr, "%s: %s\n", argv[1], img.message);
+        return 1;
+    }
+
+    const char *name = argv[2];
+    const int w = img.width;
+    const int h = img.height;
+
+    printf("/* generated by icongen from %s; do not edit */\n\n", argv[1]);
+
+    for (int i = 3; i < argc; i++) {
+        const int size = atoi(argv[i]);
+
+        /* only scale down, never up */
+        if (size < 1 || size > w || size > h) {
+            fprintf(stderr, "%s: invalid size: %s\n", argv[0], argv[i]);
+            return 1;
+        }
+
+        print_array(name, size, (size == w && size == h) ? pixels : scale(pixels, w, h, size, size));
+        sizes.push_back(size);
+    }
+
+    /* largest first */
+    printf("const int %s_sizes[] = {", name);
+    for (int s : sizes) printf(" %d,", s);
+    printf(" 0 };\n\n");
+
+    printf("const unsigned char *const %s_rgba[] = {", name);
+    for (int s : sizes) printf(" %s_%d,", name, s);
+    printf(" NULL };\n");
+
+    return 0;
+}
@@ -0,0 +1,278 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "install_index.hpp"
+#include "keyfile.hpp"
+
+#define INDEX_FILE  "installed"
+
+/* events that can change whether a directory is empty or not */
+#define WATCH_DIR_MASK  (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF)
+#define WATCH_CONF_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR)
+
+
+bool is_full_directory(const char *path)
+{
+    struct stat st;
+    struct dirent *d;
+    DIR *dirp;
+
+    if (stat(path, &st) != 0 ||
+        !S_ISDIR(st.st_mode) ||
+        (dirp = opendir(path)) == NULL)
+    {
+        return false;
+    }
+
+    while ((d = readdir(dirp)) != NULL) {
+        if (strcmp(d->d_name, ".") != 0 && strcmp(d->d_name, "..") != 0) {
+            /* directory is NOT empty */
+            closedir(dirp);
+            return true;
+        }
+    }
+
+    closedir(dirp);
+
+    /* empty directory or something else */
+    return false;
+}
+
+
+install_index::install_index(const std::string &confdir, const std::vector<std::string> &dirs)
+: m_confdir(confdir)
+{
+    if (!m_confdir.empty() && m_confdir.back() != '/') {
+        m_confdir += '/';
+    }
+
+    for (const auto &d : dirs) {
+        entry e;
+        e.dir = d;
+        m_entries.push_back(e);
+    }
+}
+
+install_index::~install_index()
+{
+    if (m_fd != -1) close(m_fd);
+}
+
+std::string install_index::path(const entry &e) const
+{
+    return (e.dir[0] == '/') ? e.dir : m_confdir + e.dir;
+}
+
+/* returns true if the state changed */
+bool install_index::refresh(entry &e)
+{
+    struct stat st;
+    const std::string path = this->path(e);
+    const bool was = e.installed;
+
+    if (stat(path.c_str(), &st) == 0) {
+        e.ino = st.st_ino;
+        e.mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    } else {
+        e.ino = 0;
+        e.mtime = 0;
+    }
+
+    e.installed = is_full_directory(path.c_str());
+
+    return (was != e.installed);
+}
+
+/* only rescan directories that were modified since the index was saved */
+void install_index::load()
+{
+    keyfile kf;
+    bool changed = !kf.load(m_confdir + INDEX_FILE);
+
+    for (auto &e : m_entries) {
+        struct stat st;
+        std::string val = kf.get(e.dir.c_str());
+        unsigned long long ino = 0;
+        long long mtime = 0;
+        int installed = 0;
+
+        if (sscanf(val.c_str(), "%d %llu %lld", &installed, &ino, &mtime) != 3 ||
+            stat(path(e).c_str(), &st) != 0 ||
+            st.st_ino != ino ||
+            static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec != mtime)
+        {
+            refresh(e);
+            changed = true;
+            continue;
+        }
+
+        e.installed = (installed != 0);
+        e.ino = ino;
+        e.mtime = mtime;
+    }
+
+    if (changed) save();
+}
+
+bool install_index::save() const
+{
+    keyfile kf;
+    char buf[64];
+
+    for (const auto &e : m_entries) {
+        snprintf(buf, sizeof(buf), "%d %llu %lld", e.installed ? 1 : 0,
+            static_cast<unsigned long long>(e.ino), static_cast<long long>(e.mtime));
+        kf.set(e.dir.c_str(), buf);
+    }
+
+    return kf.save(m_confdir + INDEX_FILE);
+}
+
+void install_index::add_watch(entry &e)
+{
+    if (m_fd != -1 && e.wd == -1) {
+        e.wd = inotify_add_watch(m_fd, path(e).c_str(), WATCH_DIR_MASK | IN_ONLYDIR);
+    }
+}
+
+size_t install_index::add(const std::string &dir)
+{
+    entry e;
+    e.dir = dir;
+    refresh(e);
+    add_watch(e);
+    m_entries.push_back(e);
+
+    return m_entries.size() - 1;
+}
+
+bool install_index::watch()
+{
+    if (m_fd == -1) {
+        m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (m_fd == -1) return false;
+    }
+
+    if (m_wd == -1) {
+        m_wd = inotify_add_watch(m_fd, m_confdir.c_str(), WATCH_CONF_MASK);
+        if (m_wd == -1) return false;
+    }
+
+    for (auto &e : m_entries) {
+        add_watch(e);
+    }
+
+    return true;
+}
+
+bool install_index::process()
+{
+    if (m_fd == -1) return false;
+
+    alignas(struct inotify_event) char buf[16*1024];
+    std::vector<bool> dirty(m_entries.size(), false);
+    bool overflow = false;
+    ssize_t len;
+
+    while ((len = read(m_fd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + len; ) {
+            const struct inotify_event *ev = reinterpret_cast<struct inotify_event *>(p);
+            p += sizeof(struct inotify_event) + ev->len;
+
+            /* the kernel's queue was full and events were dropped */
+            if (ev->wd == -1 || (ev->mask & IN_Q_OVERFLOW)) {
+                overflow = true;
+                continue;
+            }
+
+            for (size_t i = 0; i < m_entries.size(); i++) {
+                entry &e = m_entries[i];
+
+                if (ev->wd == m_wd && ev->len > 0 && e.dir == ev->name) {
+                    /* data directory was created, removed or renamed */
+                    dirty[i] = true;
+                    if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) e.wd = -1;
+                } else if (ev->wd == e.wd) {
+                    dirty[i] = true;
+                    if (ev->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) e.wd = -1;
+                }
+            }
+
+            /* the config directory itself went away */
+            if (ev->wd == m_wd && (ev->mask & IN_IGNORED)) {
+                m_wd = -1;
+            }
+        }
+    }
+
+    /* anything may have changed; a watch may even be on a directory
+     * that was moved away in the meantime, so start over */
+    if (overflow) {
+        for (auto &e : m_entries) {
+            if (e.wd != -1) inotify_rm_watch(m_fd, e.wd);
+            e.wd = -1;
+        }
+
+        if (m_wd != -1) inotify_rm_watch(m_fd, m_wd);
+        m_wd = -1;
+
+        watch();
+        dirty.assign(m_entries.size(), true);
+    }
+
+    bool changed = false;
+
+    for (size_t i = 0; i < m_entries.size(); i++) {
+        if (!dirty[i]) continue;
+
+        add_watch(m_entries[i]);
+        if (refresh(m_entries[i])) changed = true;
+    }
+
+    /* directory mtimes changed in any case */
+    if (std::find(dirty.begin(), dirty.end(), true) != dirty.end()) {
+        save();
+    }
+
+    return changed;
+}
+
+bool install_index::all_installed() const
+{
+    for (const auto &e : m_entries) {
+        if (!e.installed) return false;
+    }
+
+    return true;
+}
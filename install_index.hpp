@@ -0,0 +1,88 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef INSTALL_INDEX_HPP
+#define INSTALL_INDEX_HPP
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+
+/* Keeps track of which game data directories are installed (exist and
+ * are not empty). The state is saved in "<confdir>/installed" and only
+ * revalidated with a stat() per directory on startup; afterwards an
+ * inotify watch keeps it up to date, so queries never touch the disk. */
+class install_index
+{
+private:
+
+    struct entry
+    {
+        std::string dir;
+        bool installed = false;
+        uint64_t ino = 0;
+        int64_t mtime = 0;
+        int wd = -1;
+    };
+
+    std::string m_confdir;
+    std::vector<entry> m_entries;
+    int m_fd = -1;
+    int m_wd = -1;
+
+    std::string path(const entry &e) const;
+    bool refresh(entry &e);
+    void add_watch(entry &e);
+
+public:
+
+    /* <dirs> are relative to <confdir> or absolute paths */
+    install_index(const std::string &confdir, const std::vector<std::string> &dirs);
+    ~install_index();
+
+    /* add and check another directory; returns its index */
+    size_t add(const std::string &dir);
+
+    void load();
+    bool save() const;
+
+    /* start watching; can be called again once <confdir> was created */
+    bool watch();
+    int fd() const {return m_fd;}
+
+    /* handle pending inotify events without blocking;
+     * returns true if the state of any directory changed */
+    bool process();
+
+    size_t size() const {return m_entries.size();}
+    bool installed(size_t i) const {return m_entries.at(i).installed;}
+    bool all_installed() const;
+};
+
+/* returns true ONLY if the given path is confirmed to
+ * be a directory that is not empty (symbolic links are resolved) */
+bool is_full_directory(const char *path);
+
+#endif /* INSTALL_INDEX_HPP */
@@ -0,0 +1,94 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "keyfile.hpp"
+
+
+bool keyfile::load(const std::string &path)
+{
+    FILE *fp = fopen(path.c_str(), "re");
+    if (!fp) return false;
+
+    char line[4096];
+    m_keys.clear();
+
+    while (fgets(line, sizeof(line), fp)) {
+        line[strcspn(line, "\n")] = 0;
+        char *eq = strchr(line, '=');
+
+        if (eq && eq != line) {
+            *eq = 0;
+            m_keys[line] = eq + 1;
+        }
+    }
+
+    fclose(fp);
+
+    return true;
+}
+
+/* write to a temporary file first so the file is never half-written */
+bool keyfile::save(const std::string &path) const
+{
+    std::string tmp = path + ".tmp";
+    FILE *fp = fopen(tmp.c_str(), "we");
+    if (!fp) return false;
+
+    for (const auto &e : m_keys) {
+        fprintf(fp, "%s=%s\n", e.first.c_str(), e.second.c_str());
+    }
+
+    if (fclose(fp) != 0 || rename(tmp.c_str(), path.c_str()) != 0) {
+        remove(tmp.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+std::string keyfile::get(const char *key) const
+{
+    auto it = m_keys.find(key);
+    return (it == m_keys.end()) ? std::string() : it->second;
+}
+
+uint64_t keyfile::get_u64(const char *key) const
+{
+    return strtoull(get(key).c_str(), NULL, 10);
+}
+
+void keyfile::set(const char *key, const std::string &value)
+{
+    m_keys[key] = value;
+}
+
+void keyfile::set(const char *key, uint64_t value)
+{
+    m_keys[key] = std::to_string(value);
+}
@@ -0,0 +1,57 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef KEYFILE_HPP
+#define KEYFILE_HPP
+
+#include <map>
+#include <string>
+#include <stdint.h>
+
+
+/* small "key=value" text files used for state and cache data */
+class keyfile
+{
+private:
+
+    std::map<std::string, std::string> m_keys;
+
+public:
+
+    bool load(const std::string &path);
+
+    /* the file is replaced atomically */
+    bool save(const std::string &path) const;
+
+    void clear() {m_keys.clear();}
+    bool has(const char *key) const {return m_keys.count(key) > 0;}
+
+    std::string get(const char *key) const;
+    uint64_t get_u64(const char *key) const;
+
+    void set(const char *key, const std::string &value);
+    void set(const char *key, uint64_t value);
+};
+
+#endif /* KEYFILE_HPP */
@@ -24,15 +24,26 @@
 
 #include <FL/Fl.H>
 #include <FL/platform.H>
+#include <FL/Fl_Progress.H>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <string>
+#include <thread>
+#include <vector>
 #include <assert.h>
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <features.h>
-#include <ftw.h>
 #include <libgen.h>
+#include <signal.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/param.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 
 /* define "DEFAULT_SYSTEM_COLORS" to use system colors by default */
@@ -44,10 +55,68 @@
 #endif
 
 #include "launcher.hpp"
+#include "catalog.hpp"
+#include "dedupe.hpp"
+#include "download.hpp"
+#include "engine.hpp"
+#include "icon.hpp"
+#include "install_index.hpp"
+#include "logbuf.hpp"
+#include "manifest.hpp"
+#include "mirror.hpp"
+#include "prefetch.hpp"
+#include "rmtree.hpp"
+#include "scan.hpp"
+#include "spawn.hpp"
+#include "trace.hpp"
+#include "verify.hpp"
 #include "res.h"  /* fallback icon resource */
 
 #define LOG(MSG, ...)  if (launcher::verbose()) {printf(MSG "\n", __VA_ARGS__);}
 
+/* window moves while dragging: at most one per frame at 60 Hz */
+#define MOVE_INTERVAL (1.0 / 60.0)
+
+/* output of the download script: memory in the ring buffer and the
+ * text view, redraws per second and size of the rotated log files */
+#define LOG_RING     (256*1024)
+#define LOG_FPS      10
+#define LOG_SEGMENT  (1024*1024)
+#define LOG_KEEP     3
+
+/* the game list gets a scrollbar if there are more entries */
+#define LIST_ROWS    5
+#define SCROLLBAR_W  16
+
+/* connections for one large archive, if the server supports ranges */
+#define DOWNLOAD_SEGMENTS  6
+
+#ifndef RENAME_EXCHANGE
+#define RENAME_EXCHANGE (1 << 1)
+#endif
+
+
+#define ICON_URL "https://raw.githubusercontent.com/Aleph-One-Marathon/alephone/5653d64ba12f2cf058abcd8fd9ec2f06bcae9839/flatpak/alephone.png"
+#define GITHUB_REPO(x) "Aleph-One-Marathon/data-marathon" x
+#define REPO "https://github.com/" GITHUB_REPO("")
+#define MARATHON_DL(x) REPO x "/archive/refs/heads/master.tar.gz"
+#define GITHUB_TREE(x) "https://api.github.com/repos/" + std::string(x) + "/git/trees/master?recursive=1"
+#define GITHUB_RAW(x) "https://raw.githubusercontent.com/" + std::string(x) + "/master/"
+
+/* the Marathon trilogy is always in the catalog; more games
+ * and scenarios can be added in "~/.alephone/catalog" */
+static const struct {
+    const char *name;
+    const char *dir;
+    const char *url;
+    const char *repo;
+    uint32_t color;
+} games[3] = {
+    { "Marathon",             "data-marathon-master",          MARATHON_DL(""),          GITHUB_REPO(""),          0x0676e6 },
+    { "Marathon 2: Durandal", "data-marathon-2-master",        MARATHON_DL("-2"),        GITHUB_REPO("-2"),        0xe3bc00 },
+    { "Marathon Infinity",    "data-marathon-infinity-master", MARATHON_DL("-infinity"), GITHUB_REPO("-infinity"), 0x959595 }
+};
+
 
 bool launcher::m_verbose = false;
 
@@ -58,343 +127,1822 @@ int movebox::handle(int e)
             fl_cursor(FL_CURSOR_MOVE);
             m_event_x = Fl::event_x();
             m_event_y = Fl::event_y();
+            m_drags = m_moves = 0;
             return e;  /* return non-zero */
         case FL_DRAG:
-            window()->position(
-                Fl::event_x_root() - m_event_x,
-                Fl::event_y_root() - m_event_y);
+            /* every move is a round-trip to the X server; only
+             * apply the latest position once per frame */
+            m_move_x = Fl::event_x_root() - m_event_x;
+            m_move_y = Fl::event_y_root() - m_event_y;
+            m_drags++;
+
+            if (!m_pending) {
+                m_pending = true;
+                Fl::add_timeout(MOVE_INTERVAL, move_cb, this);
+            }
             break;
         case FL_RELEASE:
             fl_cursor(FL_CURSOR_DEFAULT);
+
+            /* the final position must not be lost */
+            if (m_pending) {
+                Fl::remove_timeout(move_cb, this);
+                move();
+            }
+
+            LOG("window drag: %u events, %u moves, %u dropped",
+                m_drags, m_moves, m_drags - m_moves);
+            break;
+    }
+
+    return Fl_Widget::handle(e);
+}
+
+void movebox::move()
+{
+    m_pending = false;
+
+    if (m_move_x != window()->x() || m_move_y != window()->y()) {
+        window()->position(m_move_x, m_move_y);
+        m_moves++;
+    }
+}
+
+void movebox::move_cb(void *p)
+{
+    reinterpret_cast<movebox *>(p)->move();
+}
+
+int logobutton::handle(int e)
+{
+    switch (e) {
+        case FL_ENTER:
+            set_color(m_col);
+            if (m_l) m_l->prefetch(this);
+            break;
+        case FL_LEAVE:
+            set_color(MARATHON_GREEN);
             break;
     }
 
-    return Fl_Widget::handle(e);
-}
+    return Fl_Button::handle(e);
+}
+
+logobox::~logobox()
+{
+    for (const auto &e : m_cache) {
+        fl_delete_offscreen(e.buf);
+    }
+}
+
+Fl_Offscreen logobox::render(Fl_Color col)
+{
+    const Fl_Color bg = window()->color();
+    Fl_Offscreen buf = fl_create_offscreen(w(), h());
+
+    fl_begin_offscreen(buf);
+    fl_rectf(0, 0, w(), h(), bg);
+    fl_draw_circle(0, 0, 200, col);
+    fl_draw_circle(35, 8, 130, bg);
+    fl_draw_circle(47, 20, 105, col);
+    fl_rectf(90, 135, 20, 66, bg);
+    fl_end_offscreen();
+
+    return buf;
+}
+
+void logobutton::hover_color(Fl_Color col)
+{
+    m_col = col;
+
+    /* the entry below the pointer changed while scrolling */
+    if (Fl::belowmouse() == this) set_color(col);
+}
+
+gamelist::gamelist(int X, int Y, int W, int row_h, int rows, int count, launcher *o)
+: Fl_Group(X, Y, W, row_h*rows), m_l(o), m_count(count)
+{
+    int bw = W;
+
+    if (count > rows) {
+        bw -= SCROLLBAR_W;
+        m_bar = new Fl_Scrollbar(X + bw, Y, SCROLLBAR_W, h());
+        m_bar->value(0, rows, 0, count);
+        m_bar->linesize(1);
+        m_bar->callback(scroll_cb, this);
+    }
+
+    for (int i = 0; i < rows; i++) {
+        logobutton *b = new logobutton(X, Y + row_h*i, bw, row_h, MARATHON_GREEN, o, NULL);
+        b->entry(i);
+        m_rows.push_back(b);
+    }
+
+    end();
+}
+
+void gamelist::scroll_to(int top)
+{
+    const int rows = m_rows.size();
+
+    if (top > m_count - rows) top = m_count - rows;
+    if (top < 0) top = 0;
+    if (top == m_top) return;
+
+    m_top = top;
+
+    for (int i = 0; i < rows; i++) {
+        m_rows[i]->entry(top + i);
+    }
+
+    if (m_bar) m_bar->value(top, rows, 0, m_count);
+    if (m_l) m_l->update_buttons();
+}
+
+void gamelist::count(int n)
+{
+    const int rows = m_rows.size();
+
+    m_count = n;
+
+    if (n > rows && !m_bar) {
+        const int bw = w() - SCROLLBAR_W;
+
+        for (logobutton *b : m_rows) {
+            b->size(bw, b->h());
+        }
+
+        m_bar = new Fl_Scrollbar(x() + bw, y(), SCROLLBAR_W, h());
+        m_bar->linesize(1);
+        m_bar->callback(scroll_cb, this);
+        add(m_bar);
+        redraw();
+    }
+
+    if (m_bar) m_bar->value(m_top, rows, 0, n);
+}
+
+void gamelist::scroll_cb(Fl_Widget *, void *p)
+{
+    gamelist *o = reinterpret_cast<gamelist *>(p);
+    o->scroll_to(o->m_bar->value());
+}
+
+int gamelist::handle(int e)
+{
+    if (e == FL_MOUSEWHEEL && m_bar && Fl::event_dy() != 0) {
+        scroll_to(m_top + Fl::event_dy());
+        return 1;
+    }
+
+    return Fl_Group::handle(e);
+}
+
+logview::logview(int X, int Y, int W, int H, const log_buffer *log, size_t max)
+: Fl_Text_Display(X,Y,W,H), m_log(log), m_max(max)
+{
+    m_text = new Fl_Text_Buffer;
+    buffer(m_text);
+    textfont(FL_COURIER);
+    textsize(12);
+    Fl::add_timeout(1.0 / LOG_FPS, update_cb, this);
+}
+
+logview::~logview()
+{
+    Fl::remove_timeout(update_cb, this);
+    buffer(NULL);
+    delete m_text;
+}
+
+void logview::update()
+{
+    std::string s, line;
+
+    if (m_log->read(m_seq, s) > 0) {
+        s.insert(0, "[...]\n");
+    }
+
+    if (s.empty()) return;
+
+    /* a carriage return that isn't part of a line break starts the
+     * line over, i.e. for progress bars */
+    for (const char c : s) {
+        if (m_cr && c != '\n') {
+            m_text->append(line.c_str());
+            line.clear();
+            m_text->remove(m_text->line_start(m_text->length()), m_text->length());
+        }
+
+        m_cr = (c == '\r');
+
+        if (c != '\r' && c != 0) line += c;
+    }
+
+    m_text->append(line.c_str());
+
+    /* drop whole lines from the top */
+    if (static_cast<size_t>(m_text->length()) > m_max) {
+        const int end = m_text->line_end(m_text->length() - m_max);
+        m_text->remove(0, end + 1);
+    }
+
+    insert_position(m_text->length());
+    show_insert_position();
+}
+
+void logview::update_cb(void *p)
+{
+    reinterpret_cast<logview *>(p)->update();
+    Fl::repeat_timeout(1.0 / LOG_FPS, update_cb, p);
+}
+
+void logobox::logo_color(Fl_Color col)
+{
+    if (col == color()) return;
+
+    color(col);
+    damage(FL_DAMAGE_ALL, x(), y(), w(), h());
+}
+
+void logobox::draw()
+{
+    Fl_Offscreen buf = 0;
+
+    /* the window is shown now, so offscreen buffers can be created */
+    if (m_cache.empty()) {
+        for (const Fl_Color col : m_colors) {
+            m_cache.push_back({ col, render(col) });
+        }
+    }
+
+    for (const auto &e : m_cache) {
+        if (e.color == color()) buf = e.buf;
+    }
+
+    if (!buf) {
+        buf = render(color());
+        m_cache.push_back({ color(), buf });
+    }
+
+    fl_copy_offscreen(x(), y(), w(), h(), buf, 0, 0);
+}
+
+void logobutton::set_color(Fl_Color col)
+{
+    if (m_l && m_l->logo()) {
+        m_l->logo()->logo_color(col);
+    }
+}
+
+int launcher_window::handle(int e)
+{
+    if (m_l && m_l->logo() && e == FL_ENTER) {
+        m_l->logo()->logo_color(MARATHON_GREEN);
+    }
+
+    return Fl_Double_Window::handle(e);
+}
+
+void launcher_window::draw()
+{
+    if (!m_drawn) {
+        trace_instant("first draw");
+        m_drawn = true;
+    }
+
+    Fl_Double_Window::draw();
+}
+
+launcher::~launcher()
+{
+    if (m_log_fd != -1) {
+        Fl::remove_fd(m_log_fd);
+        close(m_log_fd);
+    }
+
+    if (m_logwin) delete m_logwin;
+    if (m_log) delete m_log;
+
+    /* children keep running */
+    for (auto &c : m_children) {
+        Fl::remove_fd(c.proc->fd());
+        delete c.proc;
+    }
+
+    stop_dedupe();
+
+    for (auto &f : m_cleanup) {
+        f.wait();
+    }
+
+    if (m_icon) {
+        if (m_icon->fd() != -1) Fl::remove_fd(m_icon->fd());
+        delete m_icon;
+    }
+
+    if (m_win) delete m_win;
+    if (m_png) delete m_png;
+
+    for (auto *o : m_fallback_icons) {
+        delete o;
+    }
+
+    if (m_index) {
+        if (m_index->fd() != -1) Fl::remove_fd(m_index->fd());
+        delete m_index;
+    }
+
+    if (m_prefetch) delete m_prefetch;
+    if (m_engine) delete m_engine;
+    if (m_scan) {
+        if (m_scan->fd() != -1) Fl::remove_fd(m_scan->fd());
+        delete m_scan;
+    }
+
+    if (m_catalog) delete m_catalog;
+}
+
+void launcher::print_fltk_version()
+{
+    TRACE_SCOPE("print_fltk_version");
+    const int n = Fl::api_version();
+    printf("Using FLTK v%d.%d.%d - https://www.fltk.org\n", n/10000, (n/100) % 100, n%100);
+}
+
+inline void launcher::error_message(const char *msg)
+{
+    fl_message_title("Error");
+    fl_alert("%s", msg);
+}
+
+/* start a program without blocking the event loop; <done> is
+ * called with its exit status once it has finished */
+child_process *launcher::spawn(const std::vector<std::string> &argv, bool quiet,
+                               std::function<void (int status)> done,
+                               int out, int err, bool group)
+{
+    std::string s;
+
+    for (const auto &arg : argv) {
+        s += " " + arg;
+    }
+
+    LOG("+%s", s.c_str());
+    TRACE_SCOPE("spawn", s);
+
+    child_process *proc = new child_process;
+
+    if (!proc->start(argv, quiet, out, err, group)) {
+        LOG("%s", proc->error().c_str());
+        delete proc;
+        return NULL;
+    }
+
+    trace_async_begin("child process", proc->pid(), s);
+
+    /* the SIGCHLD self-pipe may already be watched for another child */
+    bool watched = false;
+
+    for (const auto &c : m_children) {
+        if (c.proc->fd() == proc->fd()) watched = true;
+    }
+
+    if (!watched) {
+        Fl::add_fd(proc->fd(), FL_READ, child_cb, this);
+    }
+
+    m_children.push_back({ proc, done });
+
+    return proc;
+}
+
+/* the pointer is on a game button: start reading its data into
+ * the page cache so that the game starts faster once it's clicked */
+void launcher::prefetch(const logobutton *o)
+{
+    const int i = o->entry();
+
+    if (i < 0 || !m_index || !m_index->installed(i)) {
+        return;
+    }
+
+    if (!m_prefetch) {
+        m_prefetch = new prefetcher;
+    }
+
+    const std::string dir = data_dir(i);
+
+    if (m_prefetch->request(dir)) {
+        LOG("prefetch: %s", dir.c_str());
+    }
+}
+
+/* look up the "alephone" executable unless the cached location is
+ * still valid; the version is queried in the background if unknown */
+bool launcher::find_engine()
+{
+    TRACE_SCOPE("find_engine");
+    const std::string cachefile = confdir() + "engine";
+
+    if (!m_engine) {
+        m_engine = new engine_info;
+        m_engine->load(cachefile);
+    }
+
+    if (!m_engine->valid()) {
+        m_engine->resolve();
+        m_engine->save(cachefile);
+    }
+
+    if (m_engine->path().empty()) {
+        LOG("%s", "engine: `alephone' not found in PATH");
+        m_engine_tooltip = "`alephone' not found in PATH";
+        update_buttons();
+        return false;
+    }
+
+    if (m_engine->version().empty()) {
+        probe_engine();
+    } else {
+        LOG("engine: %s (%s)", m_engine->path().c_str(), m_engine->version().c_str());
+        m_engine_tooltip = m_engine->version() + "\n" + m_engine->path();
+        update_buttons();
+    }
+
+    return true;
+}
+
+/* run "alephone --version" without blocking; a binary that can't
+ * tell its version is only asked again once it was replaced */
+void launcher::probe_engine()
+{
+    int fds[2];
+
+    /* still waiting for the answer */
+    if (m_engine_probing || pipe2(fds, O_CLOEXEC | O_NONBLOCK) == -1) {
+        return;
+    }
+
+    auto done = [this, fds] (int status) {
+        std::string out;
+        char buf[512];
+        ssize_t len;
+
+        m_engine_probing = false;
+
+        /* the child has exited, so everything is in the pipe */
+        while ((len = read(fds[0], buf, sizeof(buf))) > 0) {
+            out.append(buf, len);
+        }
+
+        close(fds[0]);
+
+        /* don't ask again for the same binary */
+        m_engine->version((status != 0 || out.empty()) ? "unknown version" : out);
+        m_engine->save(confdir() + "engine");
+        find_engine();
+    };
+
+    m_engine_probing = true;
+
+    if (!spawn({ m_engine->path(), "--version" }, false, done, fds[1])) {
+        m_engine_probing = false;
+        close(fds[0]);
+        close(fds[1]);
+
+        m_engine->version("unknown version");
+        m_engine->save(confdir() + "engine");
+        find_engine();
+        return;
+    }
+
+    close(fds[1]);
+}
+
+/* a child process may have exited */
+void launcher::child_cb(int, void *p)
+{
+    launcher *l = reinterpret_cast<launcher *>(p);
+    std::vector<child> finished;
+    auto &list = l->m_children;
+
+    for (auto it = list.begin(); it != list.end(); ) {
+        const int fd = it->proc->fd();
+        const pid_t pid = it->proc->pid();
+
+        if (!it->proc->poll()) {
+            ++it;
+            continue;
+        }
+
+        trace_async_end("child process", pid);
+
+        finished.push_back(*it);
+        it = list.erase(it);
+
+        bool watched = false;
+
+        for (const auto &c : list) {
+            if (c.proc->fd() == fd) watched = true;
+        }
+
+        if (!watched) {
+            Fl::remove_fd(fd);
+        }
+    }
+
+    /* callbacks may start new children */
+    for (auto &c : finished) {
+        LOG("exit status: %d", c.proc->status());
+        if (c.done) c.done(c.proc->status());
+        delete c.proc;
+    }
+}
+
+/* returns "$HOME/.alephone/"; assert if m_home is NULL */
+inline std::string launcher::confdir() const
+{
+    /* this error message will be more meaningful
+     * than the one from std::string() */
+    assert(m_home != NULL);
+
+    return std::string(m_home) + "/.alephone/";
+}
+
+/* look for PNG icons in the following order:
+ * <application path> + ".png"
+ * $HOME/.alephone/alephone.png
+ * /usr/share/icons/hicolor/<...>/apps/alephone.png
+ * /usr/share/pixmaps/alephone.png
+ *
+ * this is done in the background; the icon is set once it was decoded
+ */
+void launcher::load_default_icon()
+{
+    std::vector<std::string> list;
+
+    /* look for PNG file with the same name as the executable
+     * plus ".png" extension */
+    std::string path = get_self_exe_png();
+
+    if (!path.empty()) {
+        list.push_back(path);
+    }
+
+    /* look for ~/.alephone/alephone.png */
+    list.push_back(confdir() + "alephone.png");
+
+    /* look for "alephone.png" in system directories */
+    for (const char *res : { "512", "256", "128", "64", "48", "32", "24", "22", "16" }) {
+        list.push_back(std::string("/usr/share/icons/hicolor/") + res + "x" + res + "/apps/alephone.png");
+    }
+
+    list.push_back("/usr/share/pixmaps/alephone.png");
+
+    if (!m_icon) {
+        m_icon = new icon_loader;
+    } else if (m_icon->fd() != -1) {
+        Fl::remove_fd(m_icon->fd());
+    }
+
+    if (m_icon->start(list, confdir() + "icon")) {
+        Fl::add_fd(m_icon->fd(), FL_READ, icon_cb, this);
+    } else {
+        load_fallback_icon();
+    }
+}
+
+/* fall back to embedded default icon
+ *
+ * "input-gaming.svg" from Tango Icon Library, converted to PNG
+ * released into the Public Domain
+ * http://tango.freedesktop.org/Tango_Icon_Library
+ *
+ * the pixels are decoded at build time in all sizes (see icongen.cpp)
+ */
+void launcher::load_fallback_icon()
+{
+    if (m_fallback_icons.empty()) {
+        for (int i = 0; input_gaming_rgba[i]; i++) {
+            const int n = input_gaming_sizes[i];
+            m_fallback_icons.push_back(new Fl_RGB_Image(input_gaming_rgba[i], n, n, 4));
+        }
+    }
+
+    const Fl_RGB_Image **icons = const_cast<const Fl_RGB_Image **>(m_fallback_icons.data());
+    const int count = m_fallback_icons.size();
+
+    LOG("%s", "loaded: (embedded icon)");
+
+    Fl_Window::default_icons(icons, count);
+    if (m_win) m_win->icons(icons, count);
+
+    if (m_png) delete m_png;
+    m_png = NULL;
+}
+
+/* the icon was loaded in the background */
+void launcher::icon_cb(int fd, void *p)
+{
+    launcher *l = reinterpret_cast<launcher *>(p);
+    Fl_PNG_Image *img = l->m_icon->finish();
+
+    Fl::remove_fd(fd);
+
+    if (!img) {
+        l->load_fallback_icon();
+        return;
+    }
+
+    LOG("loaded: %s", l->m_icon->path().c_str());
+
+    if (l->m_png) delete l->m_png;
+    l->m_png = img;
+
+    /* the window may already be shown */
+    Fl_Window::default_icon(l->m_png);
+    if (l->m_win) l->m_win->icon(l->m_png);
+}
+
+/* move a file or directory out of the way into a new "trash.XXXXXX"
+ * directory inside of "$HOME/.alephone"; see remove_trash() */
+void launcher::move_to_trash(const std::string &path)
+{
+    TRACE_SCOPE("move to trash", path);
+    struct stat st;
+
+    if (lstat(path.c_str(), &st) != 0) {
+        return;
+    }
+
+    std::string trash = confdir() + "trash.XXXXXX";
+
+    if (!mkdtemp(&trash[0])) {
+        return;
+    }
+
+    const char *p = strrchr(path.c_str(), '/');
+    trash += p ? p : "/x";
+
+    LOG("move: %s -> %s", path.c_str(), trash.c_str());
+
+    if (rename(path.c_str(), trash.c_str()) != 0) {
+        LOG("rename() failed: %s", strerror(errno));
+    }
+}
+
+/* recursively remove all "trash.*" directories inside "$HOME/.alephone"
+ * on a background thread, without following symbolic links or crossing
+ * file systems; this is same as "rm -rf --one-file-system ~/.alephone/trash.*"
+ */
+void launcher::remove_trash()
+{
+    std::vector<std::string> list;
+    const std::string dir = confdir();
+    DIR *d = opendir(dir.c_str());
+
+    if (!d) return;
+
+    while (struct dirent *e = readdir(d)) {
+        if (strncmp(e->d_name, "trash.", 6) == 0) {
+            list.push_back(dir + e->d_name);
+        }
+    }
+
+    closedir(d);
+
+    if (list.empty()) return;
+
+    auto lambda = [] (std::vector<std::string> list) {
+        tree_remover rm(2);
+
+        for (const auto &path : list) {
+            LOG("delete: %s", path.c_str());
+            rm.add(path);
+        }
+
+        rm.run();
+
+        for (const auto &s : rm.failed()) {
+            LOG("%s", s.c_str());
+        }
+    };
+
+    /* forget about earlier passes that are finished */
+    m_cleanup.erase(std::remove_if(m_cleanup.begin(), m_cleanup.end(), [] (const std::future<void> &f) {
+        return f.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }), m_cleanup.end());
+
+    m_cleanup.push_back(std::async(std::launch::async, lambda, list));
+}
+
+/* let identical files of all installed games and scenarios share their
+ * data on a background thread; see file_deduper */
+void launcher::dedupe()
+{
+    std::vector<std::string> list;
+
+    /* one pass at a time */
+    stop_dedupe();
+
+    for (size_t i = 0; i < m_catalog->size(); i++) {
+        const std::string dir = data_dir(i);
+
+        /* the index may not have seen the changes yet;
+         * system-wide scenarios are left alone */
+        if (is_full_directory(dir.c_str()) && access(dir.c_str(), W_OK) == 0) {
+            list.push_back(dir);
+        }
+    }
+
+    if (list.size() < 2) return;
+
+    m_dedupe_cache = new hash_cache;
+    m_deduper = new file_deduper(*m_dedupe_cache);
+
+    for (const auto &dir : list) {
+        m_deduper->add(dir);
+    }
+
+    auto lambda = [] (hash_cache &cache, file_deduper &dd, std::string cachefile) {
+        cache.load(cachefile);
+        dd.run();
+        cache.save(cachefile);
+
+        LOG("dedupe: %zu files, %zu hashed (%.1f MiB), %zu reflinked, %zu hard linked, "
+            "%zu already shared, %zu failed, %.1f MiB saved",
+            dd.files.load(), dd.hashed.load(), dd.hashed_bytes / (1024.0*1024.0),
+            dd.cloned.load(), dd.linked.load(), dd.shared.load(), dd.failed.load(),
+            dd.saved / (1024.0*1024.0));
+    };
+
+    /* not the hash cache of verify(), which only keeps what it used */
+    m_dedupe = std::async(std::launch::async, lambda, std::ref(*m_dedupe_cache),
+                          std::ref(*m_deduper), confdir() + "dedupecache");
+}
+
+/* cancel a running dedupe() pass and wait for it, so that it can't put
+ * old content back over files that are about to be installed */
+void launcher::stop_dedupe()
+{
+    if (m_dedupe.valid()) {
+        m_deduper->cancel();
+        m_dedupe.wait();
+        m_dedupe = std::future<void>();
+    }
+
+    delete m_deduper;
+    delete m_dedupe_cache;
+    m_deduper = NULL;
+    m_dedupe_cache = NULL;
+}
+
+/* replace a game data directory with the one extracted into <staging>;
+ * the old data ends up in <staging> */
+bool launcher::install_staged(const std::string &staging, int i)
+{
+    const std::string from = staging + "/" + m_catalog->at(i).dir;
+    const std::string to = confdir() + m_catalog->at(i).dir;
+
+    LOG("install: %s -> %s", from.c_str(), to.c_str());
+
+#ifdef SYS_renameat2
+    /* atomically swap both directories */
+    if (syscall(SYS_renameat2, AT_FDCWD, from.c_str(), AT_FDCWD, to.c_str(), RENAME_EXCHANGE) == 0) {
+        return true;
+    }
+
+    /* not supported by the kernel or file system */
+    if (errno == EINVAL || errno == ENOSYS) {
+        move_to_trash(to);
+    } else if (errno != ENOENT) {
+        return false;
+    }
+#else
+    move_to_trash(to);
+#endif
+
+    /* nothing installed yet */
+    return (rename(from.c_str(), to.c_str()) == 0);
+}
+
+/* check if there's a file list of ALL downloadable game data directories */
+bool launcher::all_manifests_exist()
+{
+    for (const auto &e : m_catalog->entries()) {
+        std::string path = confdir() + e.dir + ".manifest";
+
+        if (!e.url.empty() && access(path.c_str(), R_OK) != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* check if ALL downloadable game data directories exist, i.e.:
+ * ~/.alephone/data-marathon-master
+ * ~/.alephone/data-marathon-2-master
+ * ~/.alephone/data-marathon-infinity-master
+ *
+ * this is answered from the install index; pending
+ * inotify events are applied first
+ */
+bool launcher::all_directories_exist()
+{
+    if (m_index->process()) update_buttons();
+
+    for (size_t i = 0; i < m_catalog->size(); i++) {
+        if (!m_catalog->at(i).url.empty() && !m_index->installed(i)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* the built-in games plus the entries of the catalog file */
+static void read_catalog(catalog &cat, const std::string &confdir)
+{
+    const std::string path = confdir + "catalog";
+
+    for (const auto &g : games) {
+        catalog_entry e;
+        e.name = g.name;
+        e.dir = g.dir;
+        e.url = g.url;
+        e.repo = g.repo;
+        e.color = g.color;
+        cat.add(e);
+    }
+
+    if (cat.load(path)) {
+        LOG("catalog: %s (%zu entries)", path.c_str(), cat.size());
+    }
+
+    if (!cat.error().empty()) {
+        fprintf(stderr, "%s: entries ignored:\n%s", path.c_str(), cat.error().c_str());
+    }
+}
+
+void launcher::load_catalog()
+{
+    TRACE_SCOPE("load_catalog");
+    m_catalog = new catalog;
+    read_catalog(*m_catalog, confdir());
+}
+
+/* add the scenarios that were found last time, so that the
+ * window has the right size from the start */
+void launcher::load_scenarios()
+{
+    TRACE_SCOPE("load_scenarios");
+    const char *env = getenv("XDG_DATA_HOME");
+    std::string dirs = env && *env ? env : std::string(m_home) + "/.local/share";
+
+    m_scan = new scenario_scanner(4);
+    m_scan->add_root(confdir());
+    m_scan->exclude(confdir() + "staging");
+    m_scan->exclude(confdir() + "cache");
+    m_scan->exclude(confdir() + "trash.");
+
+    /* $XDG_DATA_HOME/AlephOne, then the same in every $XDG_DATA_DIRS */
+    env = getenv("XDG_DATA_DIRS");
+    dirs += ":";
+    dirs += env && *env ? env : "/usr/local/share:/usr/share";
+
+    for (size_t pos = 0, end; pos < dirs.size(); pos = end + 1) {
+        end = dirs.find(':', pos);
+        if (end == std::string::npos) end = dirs.size();
+
+        if (dirs[pos] == '/') {
+            m_scan->add_root(dirs.substr(pos, end - pos) + "/AlephOne");
+        }
+    }
+
+    m_scan->load(confdir() + "scenarios");
+
+    for (const auto &path : m_scan->cached_scenarios()) {
+        add_scenario(path);
+    }
+}
+
+/* revalidate the scenario list in the background */
+void launcher::scan_scenarios()
+{
+    if (m_scan->start(confdir() + "scenarios")) {
+        Fl::add_fd(m_scan->fd(), FL_READ, scan_cb, this);
+    }
+}
+
+/* returns false if the scenario is already in the catalog */
+bool launcher::add_scenario(const std::string &path)
+{
+    std::string dir = path;
+
+    /* games that were downloaded have a relative directory */
+    if (dir.compare(0, confdir().size(), confdir()) == 0 &&
+        dir.find('/', confdir().size()) == std::string::npos)
+    {
+        dir.erase(0, confdir().size());
+    }
+
+    if (m_catalog->has(dir)) {
+        return false;
+    }
+
+    catalog_entry e;
+    e.name = path.substr(path.rfind('/') + 1);
+    e.dir = dir;
+    m_catalog->add(e);
+
+    return true;
+}
+
+/* the scenario scan has finished */
+void launcher::scan_cb(int fd, void *p)
+{
+    launcher *l = reinterpret_cast<launcher *>(p);
+    int added = 0;
+
+    Fl::remove_fd(fd);
+    l->m_scan->finish();
+
+    LOG("scenario scan: %zu found, %lu directories read, %lu unchanged",
+        l->m_scan->found().size(), static_cast<unsigned long>(l->m_scan->dirs_read),
+        static_cast<unsigned long>(l->m_scan->dirs_cached));
+
+    for (const auto &path : l->m_scan->found()) {
+        if (!l->add_scenario(path)) continue;
+
+        LOG("new scenario: %s", path.c_str());
+        l->m_index->add(l->m_catalog->at(l->m_catalog->size() - 1).dir);
+        added++;
+    }
+
+    if (added > 0) {
+        l->m_index->save();
+        l->m_list->count(l->m_catalog->size());
+        l->update_buttons();
+    }
+}
+
+/* full path of the data directory of a catalog entry */
+std::string launcher::data_dir(size_t i) const
+{
+    const std::string &dir = m_catalog->at(i).dir;
+    return (dir[0] == '/') ? dir : confdir() + dir;
+}
+
+/* load the install index and start watching the data directories */
+void launcher::load_index()
+{
+    TRACE_SCOPE("load_index");
+    std::vector<std::string> dirs;
+
+    for (const auto &e : m_catalog->entries()) {
+        dirs.push_back(e.dir);
+    }
+
+    m_index = new install_index(confdir(), dirs);
+    m_index->load();
+    watch_index();
+}
+
+void launcher::watch_index()
+{
+    if (m_index->fd() != -1) {
+        Fl::remove_fd(m_index->fd());
+    }
+
+    if (!m_index->watch()) {
+        LOG("cannot watch: %s", confdir().c_str());
+    }
+
+    if (m_index->fd() != -1) {
+        Fl::add_fd(m_index->fd(), FL_READ, index_cb, this);
+    }
+}
+
+/* inotify events are pending */
+void launcher::index_cb(int, void *p)
+{
+    launcher *l = reinterpret_cast<launcher *>(p);
+    if (l->m_index->process()) l->update_buttons();
+}
+
+/* grey out the labels of games that aren't installed */
+void launcher::update_buttons()
+{
+    if (!m_list) return;
+
+    for (logobutton *o : m_list->buttons()) {
+        const int i = o->entry();
+        const catalog_entry &e = m_catalog->at(i);
+
+        o->label(e.name.c_str());
+        o->hover_color(fl_rgb_color(e.color >> 16, (e.color >> 8) & 0xff, e.color & 0xff));
+
+        if (m_index->installed(i)) {
+            o->labelcolor(FL_FOREGROUND_COLOR);
+            o->tooltip(m_engine_tooltip.empty() ? NULL : m_engine_tooltip.c_str());
+        } else if (e.url.empty()) {
+            o->labelcolor(fl_inactive(FL_FOREGROUND_COLOR));
+            o->tooltip("Not installed");
+        } else {
+            o->labelcolor(fl_inactive(FL_FOREGROUND_COLOR));
+            o->tooltip("Not installed; click \"Download\" to get the game files");
+        }
+
+        o->redraw_label();
+    }
+}
+
+/* use a custom script to download the Marathon game files;
+ * checks for tools or the existence of paths must be done
+ * by the script;
+ * this can be used i.e. to download using a different tool
+ * like such as git or to download from a different website
+ */
+void launcher::script(const char *p)
+{
+    if (!p || *p == 0) return;
+    m_script = p;
+    LOG("using custom download script: %s", m_script);
+}
+
+/* run the custom download script; its output is shown in a log
+ * window and written to "download.log"; the launcher window is
+ * shown again once the log window was closed */
+bool launcher::download_script()
+{
+    int fds[2];
+
+    /* create ~/.alephone */
+    if (mkdir(confdir().c_str(), 0775) == 0) {
+        watch_index();
+    }
+
+    fl_message_title("Custom download script");
+    const char *msg = "Do you want to (re-)download the game files using this custom script?";
+
+    /* always ask when using a custom script */
+    if (fl_ask("%s\n\n>> %s", msg, m_script) == 0) {
+        return false;
+    }
+
+    stop_dedupe();
+
+    if (pipe2(fds, O_CLOEXEC | O_NONBLOCK) == -1) {
+        error_message(strerror(errno));
+        return false;
+    }
+
+    /* the previous log is rotated */
+    const std::string log = confdir() + "download.log";
+
+    if (!m_log) m_log = new log_buffer(LOG_RING);
+
+    if (!m_log->open(log, LOG_SEGMENT, LOG_KEEP)) {
+        LOG("cannot write: %s", log.c_str());
+    }
+
+    m_log->print("+ %s\n", m_script);
+
+    auto done = [this] (int status) {
+        m_script_proc = NULL;
+        read_log();
+        m_log->print("\n[exit status: %d]\n", status);
+
+        if (status == 0) dedupe();
+
+        if (m_logwin->shown()) {
+            m_logwin->label((status == 0) ? "Download finished" : "Download failed");
+        } else {
+            close_log();
+        }
+    };
+
+    /* own process group, so that aborting reaches everything it started */
+    m_script_proc = spawn({ "sh", "-c", m_script }, false, done, -1, fds[1], true);
+    close(fds[1]);
+
+    if (!m_script_proc) {
+        close(fds[0]);
+        m_log->close();
+        error_message("cannot start the download script");
+        return false;
+    }
+
+    m_log_fd = fds[0];
+    Fl::add_fd(m_log_fd, FL_READ, log_cb, this);
+
+    m_logwin = new Fl_Double_Window(m_win->x(), m_win->y(), 640, 400, "Download (close window to abort)");
+    logview *o = new logview(0, 0, m_logwin->w(), m_logwin->h(), m_log, LOG_RING);
+    m_logwin->resizable(o);
+    m_logwin->end();
+    m_logwin->callback(logwin_cb, this);
+    m_logwin->show();
+
+    return true;
+}
+
+/* move the output of the script into the log */
+void launcher::read_log()
+{
+    char buf[16*1024];
+    ssize_t len;
+
+    if (m_log_fd == -1) return;
+
+    while ((len = read(m_log_fd, buf, sizeof(buf))) != 0) {
+        if (len > 0) {
+            m_log->append(buf, len);
+        } else if (errno != EINTR) {
+            break;
+        }
+    }
+
+    /* end of file, the script and all of its children are gone;
+     * or a real error */
+    if (len == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+        Fl::remove_fd(m_log_fd);
+        close(m_log_fd);
+        m_log_fd = -1;
+    }
+}
+
+void launcher::log_cb(int, void *p)
+{
+    reinterpret_cast<launcher *>(p)->read_log();
+}
+
+/* the script has finished and its log window was closed */
+void launcher::close_log()
+{
+    if (m_log_fd != -1) {
+        Fl::remove_fd(m_log_fd);
+        close(m_log_fd);
+        m_log_fd = -1;
+    }
+
+    if (m_logwin) {
+        Fl::delete_widget(m_logwin);
+        m_logwin = NULL;
+    }
+
+    m_log->close();
+
+    load_default_icon();
+    m_win->show();
+}
+
+/* the log window was closed; abort the script if it's still running */
+void launcher::logwin_cb(Fl_Widget *o, void *p)
+{
+    launcher *l = reinterpret_cast<launcher *>(p);
+
+    o->hide();
+
+    if (l->m_script_proc) {
+        /* the log is closed once the script has exited */
+        l->m_log->print("\n[aborted]\n");
+        l->m_script_proc->kill(SIGTERM);
+        return;
+    }
+
+    l->close_log();
+}
+
+/* let the jobs fall back to the mirrors listed in "~/.alephone/mirrors";
+ * with <probe> all sources are tried first and the fastest one is used */
+static void choose_sources(std::vector<std::unique_ptr<download_job>> &jobs,
+                           const std::string &confdir, bool probe)
+{
+    const std::string path = confdir + "mirrors";
+    mirror_list mirrors;
+
+    if (!mirrors.load(path)) return;
+
+    if (!mirrors.error().empty()) {
+        fprintf(stderr, "%s: lines ignored:\n%s", path.c_str(), mirrors.error().c_str());
+    }
+
+    mirror_prober prober;
+    size_t probes = 0;
+
+    for (const auto &job : jobs) {
+        job->sources = mirrors.sources(job->url);
+
+        if (probe && job->sources.size() > 1) {
+            for (const auto &url : job->sources) {
+                prober.add(url);
+                probes++;
+            }
+        }
+    }
+
+    if (probes == 0) return;
+
+    /* keep the window responsive */
+    std::atomic<bool> finished(false);
+    std::thread t([&] () {
+        prober.run();
+        finished = true;
+    });
+
+    while (!finished) {
+        Fl::wait(0.05);
+    }
+
+    t.join();
 
-int logobutton::handle(int e)
-{
-    switch (e) {
-        case FL_ENTER:
-            set_color(m_col);
-            break;
-        case FL_LEAVE:
-            set_color(MARATHON_GREEN);
-            break;
+    for (const auto &p : prober.probes()) {
+        if (p.ttfb < 0) {
+            LOG("probe: %s: %s", p.url.c_str(), p.error.c_str());
+        } else {
+            LOG("probe: %s: %.0f ms, %.1f MiB/s", p.url.c_str(), p.ttfb * 1000, p.rate / (1024*1024));
+        }
     }
 
-    return Fl_Button::handle(e);
+    for (const auto &job : jobs) {
+        prober.rank(job->sources);
+        if (job->sources.size() > 1) LOG("source: %s", job->sources[0].c_str());
+    }
 }
 
-void logobutton::set_color(Fl_Color col)
+/* download the game data; returning "true" means
+ * the window icon should be reloaded
+ */
+bool launcher::download()
 {
-    if (!m_l) return;
+    std::string s;
 
-    circle *o1 = m_l->logo1();
-    circle *o2 = m_l->logo2();
+    /* create ~/.alephone */
+    if (mkdir(confdir().c_str(), 0775) == 0) {
+        watch_index();
+    }
+
+    /* ask the user if they want to download everything again */
+    if (all_directories_exist()) {
+        if (all_manifests_exist()) {
+            fl_message_title("Update?");
+            const char *msg = "Do you want to update the game files or download everything again?";
+
+            switch (fl_choice("%s", "Cancel", "Update", "Re-download", msg)) {
+                case 0:
+                    return false;
+                case 1:
+                    return update();
+                default:
+                    break;
+            }
+        } else {
+            fl_message_title("Download again?");
 
-    if (o1 && o2) {
-        o1->color(col);
-        o2->color(col);
-        parent()->redraw();
+            if (fl_ask("%s", "Do you want to re-download the game files?") == 0) {
+                return false;
+            }
+        }
     }
-}
 
-int launcher_window::handle(int e)
-{
-    if (m_l && e == FL_ENTER) {
-        circle *o1 = m_l->logo1();
-        circle *o2 = m_l->logo2();
+    stop_dedupe();
+
+    /* extract into a staging directory so that the current data
+     * stays usable until the new data is complete; remains of an
+     * earlier attempt are removed in the background */
+    const std::string staging = confdir() + "staging";
+    move_to_trash(staging);
+    mkdir(staging.c_str(), 0775);
+
+    /* the icon is only replaced once it was downloaded */
+    s = confdir() + "alephone.png";
+
+    std::vector<manifest> files(m_catalog->size());
+    std::vector<std::unique_ptr<tar_sink>> sinks;
+    std::vector<std::unique_ptr<download_job>> jobs;
+    std::vector<size_t> owner;
+    file_sink icon(s);
+
+    /* ignore error on icon download but not on game data */
+    jobs.emplace_back(new download_job("Icon", ICON_URL, &icon, true));
+    owner.push_back(0);
+
+    /* unchanged archives are installed from the local cache */
+    s = confdir() + "cache";
+    mkdir(s.c_str(), 0775);
+
+    for (size_t i = 0; i < m_catalog->size(); i++) {
+        const catalog_entry &e = m_catalog->at(i);
+        if (e.url.empty()) continue;
+
+        /* one directory per archive so that they can't overwrite
+         * each other's files */
+        const std::string dest = staging + "/" + std::to_string(i);
+        mkdir(dest.c_str(), 0775);
+
+        sinks.emplace_back(new tar_sink(dest, &files[i], e.dir));
+        jobs.emplace_back(new download_job(e.name, e.url, sinks.back().get()));
+        owner.push_back(i);
+
+        /* keep the archives around until they're complete so
+         * that an interrupted download can be resumed */
+        jobs.back()->spool = confdir() + e.dir + ".tar.gz";
+        jobs.back()->cache = s;
+        jobs.back()->repack = m_repack;
+        jobs.back()->segments = DOWNLOAD_SEGMENTS;
+    }
+
+    /* the fastest server for every archive */
+    choose_sources(jobs, confdir(), true);
+
+    /* download everything at once */
+    download_pool pool(4);
+
+    for (const auto &job : jobs) {
+        LOG("download: %s", job->url.c_str());
+        pool.add(job.get());
+    }
+
+    bool ok = transfer(pool);
 
-        if (o1 && o2) {
-            o1->color(MARATHON_GREEN);
-            o2->color(MARATHON_GREEN);
-            redraw();
+    /* swap in the complete game data directories
+     * and save their file lists for later updates */
+    for (size_t j = 1; j < jobs.size(); j++) {
+        download_job *job = jobs[j].get();
+        const size_t i = owner[j];
+
+        if (job->state != DOWNLOAD_DONE) {
+            continue;
+        }
+
+        if (install_staged(staging + "/" + std::to_string(i), i)) {
+            files[i].save(confdir() + m_catalog->at(i).dir + ".manifest");
+        } else {
+            job->error = std::string("cannot install: ") + strerror(errno);
+            job->state = DOWNLOAD_FAILED;
+            ok = false;
         }
     }
 
-    return Fl_Double_Window::handle(e);
-}
+    /* delete the old data after the window is usable again */
+    move_to_trash(staging);
+    remove_trash();
+    dedupe();
 
-void launcher::print_fltk_version()
-{
-    const int n = Fl::api_version();
-    printf("Using FLTK v%d.%d.%d - https://www.fltk.org\n", n/10000, (n/100) % 100, n%100);
-}
+    /* the same log as for the custom script */
+    if (!m_log) m_log = new log_buffer(LOG_RING);
 
-inline void launcher::error_message(const char *msg)
-{
-    fl_message_title("Error");
-    fl_alert("%s", msg);
-}
+    if (m_log->open(confdir() + "download.log", LOG_SEGMENT, LOG_KEEP)) {
+        for (const auto &job : jobs) {
+            m_log->print("%s: %s\n  %s (%.1f MiB)%s%s\n", job->name.c_str(), job->url.c_str(),
+                (job->state == DOWNLOAD_DONE) ? "done" : "failed", job->received / (1024.0*1024.0),
+                job->error.empty() ? "" : ": ", job->error.c_str());
+        }
 
-inline int launcher::command(const char *cmd)
-{
-    Fl::flush();
-    LOG("+ %s", cmd);
-    return system(cmd);
+        m_log->close();
+    }
+
+    if (!ok && !pool.cancelled()) {
+        s = "Download failed:";
+
+        for (const auto &job : jobs) {
+            if (job->state == DOWNLOAD_FAILED && !job->optional) {
+                s += "\n" + job->name + ": " + job->error;
+            }
+        }
+
+        error_message(s.c_str());
+    }
+
+    return true;
 }
 
-/* returns "$HOME/.alephone/"; assert if m_home is NULL */
-inline std::string launcher::confdir() const
+/* show a progress window while the download pool is running;
+ * closing the window cancels all downloads; many small downloads
+ * share a single progress bar */
+bool launcher::transfer(download_pool &pool)
 {
-    /* this error message will be more meaningful
-     * than the one from std::string() */
-    assert(m_home != NULL);
+    TRACE_SCOPE("transfer");
+    const std::vector<download_job *> &jobs = pool.jobs();
+    const int n = jobs.size();
+    const int rows = (n > 5) ? 1 : n;
+    std::vector<Fl_Progress *> bars;
+    std::vector<std::string> labels(rows);
+
+    Fl_Double_Window win(m_win->x(), m_win->y(), 400, 20 + 30*rows, "Download (close window to abort)");
+    win.begin();
+
+    for (int i = 0; i < rows; i++) {
+        Fl_Progress *o = new Fl_Progress(10, 10 + 30*i, win.w() - 20, 24);
+        o->minimum(0);
+        o->maximum(1);
+        o->selection_color(MARATHON_BLUE);
+        o->labelsize(12);
+        bars.push_back(o);
+    }
 
-    return std::string(m_home) + "/.alephone/";
+    win.end();
+    win.callback([] (Fl_Widget *o, void *p) {
+        reinterpret_cast<download_pool *>(p)->cancel();
+        o->hide();
+    }, &pool);
+
+    win.show();
+    pool.start();
+
+    while (!pool.done()) {
+        char buf[64];
+
+        if (rows == 1 && n > 1) {
+            uint64_t received = 0;
+            int done = 0;
+
+            for (const download_job *job : jobs) {
+                received += job->received;
+                if (job->state == DOWNLOAD_DONE || job->state == DOWNLOAD_FAILED) done++;
+            }
+
+            snprintf(buf, sizeof(buf), "%d of %d files (%.1f MiB)", done, n, received / (1024.0*1024.0));
+            labels[0] = buf;
+            bars[0]->label(labels[0].c_str());
+            bars[0]->value(static_cast<float>(done) / n);
+            bars[0]->redraw();
+
+            Fl::wait(0.1);
+            continue;
+        }
+
+        for (int i = 0; i < n; i++) {
+            const download_job *job = jobs[i];
+            const double mib = job->received / (1024.0*1024.0);
+
+            switch (job->state) {
+                case DOWNLOAD_QUEUED:
+                    snprintf(buf, sizeof(buf), "waiting");
+                    break;
+                case DOWNLOAD_RUNNING:
+                    snprintf(buf, sizeof(buf), "%.1f MiB", mib);
+                    break;
+                case DOWNLOAD_DONE:
+                    snprintf(buf, sizeof(buf), "done (%.1f MiB)", mib);
+                    break;
+                default:
+                    snprintf(buf, sizeof(buf), "failed");
+                    break;
+            }
+
+            labels[i] = job->name + ": " + buf;
+            bars[i]->label(labels[i].c_str());
+
+            if (job->total > 0) {
+                bars[i]->value(static_cast<float>(job->received) / job->total);
+            } else if (job->state == DOWNLOAD_DONE) {
+                bars[i]->value(1);
+            }
+
+            bars[i]->redraw();
+        }
+
+        Fl::wait(0.1);
+    }
+
+    pool.wait();
+    win.hide();
+
+    for (int i = 0; i < n; i++) {
+        if (jobs[i]->state == DOWNLOAD_FAILED) {
+            LOG("failed: %s (%s)", jobs[i]->url.c_str(), jobs[i]->error.c_str());
+        }
+    }
+
+    return pool.success();
 }
 
-bool launcher::default_icon_png(const char *path)
+/* percent-encode a path for use in a URL */
+static std::string url_encode(const std::string &path)
 {
-    if (m_png) delete m_png;
-    m_png = new Fl_PNG_Image(path);
+    std::string s;
+    char buf[4];
 
-    if (m_png->fail()) {
-        LOG("cannot load: %s", path);
-        delete m_png;
-        m_png = NULL;
-        return false;
+    for (const unsigned char c : path) {
+        if (isalnum(c) || strchr("/-._~", c)) {
+            s += c;
+        } else {
+            snprintf(buf, sizeof(buf), "%%%02X", c);
+            s += buf;
+        }
     }
 
-    LOG("loaded: %s", path);
-    Fl_Window::default_icon(m_png);
-
-    return true;
+    return s;
 }
 
-/* look for PNG icons in the following order:
- * <application path> + ".png"
- * $HOME/.alephone/alephone.png
- * /usr/share/icons/hicolor/<...>/apps/alephone.png
- * /usr/share/pixmaps/alephone.png
- */
-void launcher::load_default_icon()
+/* only download the files that changed upstream since the last
+ * download and delete the ones that were removed upstream */
+bool launcher::update()
 {
-    /* look for PNG file with the same name as the executable
-     * plus ".png" extension */
+    TRACE_SCOPE("update");
+    std::vector<const catalog_entry *> list;
+    std::string s;
 
-    std::string path = get_self_exe_png();
+    stop_dedupe();
 
-    if (!path.empty() && default_icon_png(path.c_str())) {
-        return;
+    /* only installed entries with a Github repository have file lists */
+    for (size_t i = 0; i < m_catalog->size(); i++) {
+        const catalog_entry &e = m_catalog->at(i);
+        if (!e.repo.empty() && m_index->installed(i)) list.push_back(&e);
     }
 
-    /* look for ~/.alephone/alephone.png */
-    path = confdir() + "alephone.png";
-    if (default_icon_png(path.c_str())) return;
+    const size_t n = list.size();
+    std::vector<manifest> local(n), remote(n);
+    std::vector<memory_sink> lists(n);
 
-    /* look for "alephone.png" in system directories */
-#define GET_HICOLOR(RES) default_icon_png("/usr/share/icons/hicolor/" RES "x" RES "/apps/alephone.png")
-
-    if (GET_HICOLOR("512")) return;
-    if (GET_HICOLOR("256")) return;
-    if (GET_HICOLOR("128")) return;
-    if (GET_HICOLOR("64")) return;
-    if (GET_HICOLOR("48")) return;
-    if (GET_HICOLOR("32")) return;
-    if (GET_HICOLOR("24")) return;
-    if (GET_HICOLOR("22")) return;
-    if (GET_HICOLOR("16")) return;
-
-    if (default_icon_png("/usr/share/pixmaps/alephone.png")) return;
-
-    /* fall back to embedded default icon */
-
-    /* "input-gaming.svg" from Tango Icon Library, converted to PNG
-     * released into the Public Domain
-     * http://tango.freedesktop.org/Tango_Icon_Library
-     */
-    if (m_png) delete m_png;
-    m_png = new Fl_PNG_Image(NULL, input_gaming_png, input_gaming_png_len);
+    /* get the current file lists */
+    download_pool pool(4);
+    std::vector<std::unique_ptr<download_job>> jobs;
 
-    if (m_png->fail()) {
-        delete m_png;
-        m_png = NULL;
-    } else {
-        Fl_Window::default_icon(m_png);
+    for (size_t i = 0; i < n; i++) {
+        local[i].load(confdir() + list[i]->dir + ".manifest");
+        jobs.emplace_back(new download_job(list[i]->name, GITHUB_TREE(list[i]->repo), &lists[i]));
+        pool.add(jobs.back().get());
     }
-}
 
-/* recursively remove <dir> inside "$HOME/.alephone" without following
- * symbolic links; this is same as the command "rm -rf ~/.alephone/<dir>"
- */
-bool launcher::remove_data(const char *dir)
-{
-    auto lambda = [] (const char *fpath, const struct stat *, int, struct FTW *) -> int {
-        return remove(fpath);
-    };
+    /* not worth probing for the small file lists */
+    choose_sources(jobs, confdir(), false);
 
-    const int flags = FTW_DEPTH | FTW_MOUNT | FTW_PHYS;
-    std::string path = confdir() + dir;
+    if (!transfer(pool)) {
+        if (!pool.cancelled()) {
+            s = "Cannot get the list of files:";
 
-    LOG("delete: %s", path.c_str());
+            for (const auto &job : jobs) {
+                if (job->state == DOWNLOAD_FAILED) {
+                    s += "\n" + job->name + ": " + job->error;
+                }
+            }
 
-    if (nftw(path.c_str(), lambda, 20, flags) != 0 && errno != ENOENT) {
-        fl_message_title("Error");
-        fl_alert("Failed to delete:\n%s", path.c_str());
+            error_message(s.c_str());
+        }
         return false;
     }
 
-    return true;
-}
+    /* compare */
+    download_pool files(8);
+    std::vector<std::unique_ptr<file_sink>> sinks;
+    std::vector<size_t> owner;
 
-/* returns true ONLY if the given path is confirmed to
- * be a directory that is not empty (symbolic links are resolved)
- */
-bool launcher::is_full_directory(const char *path)
-{
-    struct stat st;
-    struct dirent *d;
-    DIR *dirp;
+    for (size_t i = 0; i < n; i++) {
+        std::vector<std::string> changed, gone;
+        const std::string dir = confdir() + list[i]->dir + "/";
 
-    if (stat(path, &st) != 0 ||
-        !S_ISDIR(st.st_mode) ||
-        (dirp = opendir(path)) == NULL)
-    {
+        if (!remote[i].parse_github_tree(lists[i].data(), s)) {
+            error_message((list[i]->name + ": " + s).c_str());
+            return false;
+        }
+
+        local[i].diff(remote[i], changed, gone);
+        LOG("%s: %zu changed, %zu removed", list[i]->name.c_str(), changed.size(), gone.size());
+
+        for (const auto &path : changed) {
+            const manifest_entry *e = remote[i].find(path);
+            std::string url = std::string(GITHUB_RAW(list[i]->repo)) + url_encode(path);
+
+            sinks.emplace_back(new file_sink(dir + path, e->sha1, e->size));
+            jobs.emplace_back(new download_job(path, url, sinks.back().get()));
+            files.add(jobs.back().get());
+            owner.push_back(i);
+        }
+
+        for (const auto &path : gone) {
+            if (!manifest_safe_path(path)) {
+                LOG("unsafe path ignored: %s", path.c_str());
+                local[i].erase(path);
+                continue;
+            }
+
+            s = dir + path;
+            LOG("delete: %s", s.c_str());
+            remove(s.c_str());
+            local[i].erase(path);
+        }
+    }
+
+    if (files.jobs().empty()) {
+        for (size_t i = 0; i < n; i++) {
+            local[i].save(confdir() + list[i]->dir + ".manifest");
+        }
+
+        fl_message_title("Update");
+        fl_message("%s", "The game files are up to date.");
         return false;
     }
 
-    while ((d = readdir(dirp)) != NULL) {
-        if (strcmp(d->d_name, ".") != 0 && strcmp(d->d_name, "..") != 0) {
-            /* directory is NOT empty */
-            closedir(dirp);
-            return true;
+    /* too many small files to probe them */
+    choose_sources(jobs, confdir(), false);
+    bool ok = transfer(files);
+
+    /* remember what was updated, even if not everything was */
+    for (size_t i = 0; i < files.jobs().size(); i++) {
+        const download_job *job = files.jobs()[i];
+
+        if (job->state == DOWNLOAD_DONE) {
+            const manifest_entry *e = remote[owner[i]].find(job->name);
+            local[owner[i]].set(job->name, e->size, e->sha1);
         }
     }
 
-    closedir(dirp);
+    for (size_t i = 0; i < n; i++) {
+        local[i].save(confdir() + list[i]->dir + ".manifest");
+    }
+
+    dedupe();
+
+    if (!ok && !files.cancelled()) {
+        s = "Update failed:";
+
+        for (const download_job *job : files.jobs()) {
+            if (job->state == DOWNLOAD_FAILED) {
+                s += "\n" + job->name + ": " + job->error;
+                break;
+            }
+        }
+
+        error_message(s.c_str());
+    }
 
-    /* empty directory or something else */
     return false;
 }
 
-/* check if ALL game data directories exist:
- * ~/.alephone/data-marathon-master
- * ~/.alephone/data-marathon-2-master
- * ~/.alephone/data-marathon-infinity-master
- */
-bool launcher::all_directories_exist()
+/* add all games that have a file list to <v>;
+ * returns the number of games added */
+static int add_games(verifier &v, const catalog &cat, const std::string &confdir)
 {
-    const char *paths[3] = {
-        "data-marathon-master",
-        "data-marathon-2-master",
-        "data-marathon-infinity-master"
-    };
+    int n = 0;
 
-    for (int i = 0; i < 3; i++) {
-        std::string path = confdir() + paths[i];
+    for (const auto &e : cat.entries()) {
+        manifest m;
 
-        if (!is_full_directory(path.c_str())) {
-            return false;
+        /* scenarios that were found on disk have no file lists */
+        if (e.dir[0] == '/') continue;
+
+        if (m.load(confdir + e.dir + ".manifest")) {
+            v.add(confdir + e.dir, m);
+            n++;
+        } else {
+            LOG("no file list: %s", e.dir.c_str());
         }
     }
 
-    return true;
-}
-
-/* use a custom script to download the Marathon game files;
- * checks for tools or the existence of paths must be done
- * by the script;
- * this can be used i.e. to download using a different tool
- * like such as git or to download from a different website
- */
-void launcher::script(const char *p)
-{
-    if (!p || *p == 0) return;
-    m_script = p;
-    LOG("using custom download script: %s", m_script);
+    return n;
 }
 
-/* open xterm and download the game data;
- * returning "true" means the window icon should be reloaded
- */
-bool launcher::download()
+/* hash all installed files and compare them against their file lists;
+ * offers to download damaged files again */
+bool launcher::verify()
 {
-    char buf[256];
-    const char *fmt = "xterm "
-        "-title 'Download (close window to abort)' " /* window title */
-        "-geometry 100x30+%d+%d "                    /* size + position */
-        "-l -lf ~/.alephone/download.log "           /* log output to file */
-        "-e '";
+    TRACE_SCOPE("verify");
+    hash_cache cache;
+    verifier v(cache);
+    const std::string cachefile = confdir() + "hashcache";
 
-    /* create ~/.alephone */
-    mkdir(confdir().c_str(), 0775);
+    stop_dedupe();
 
-    /* delete log file */
-    std::string s = confdir() + "download.log";
-    LOG("delete: %s", s.c_str());
-    remove(s.c_str());
+    if (add_games(v, *m_catalog, confdir()) == 0) {
+        error_message("There are no file lists to check against.\n"
+            "Please download the game files first.");
+        return false;
+    }
 
-    /* run custom download script */
-    if (m_script) {
-        fl_message_title("Custom download script");
-        const char *msg = "Do you want to (re-)download the game files using this custom script?";
+    cache.load(cachefile);
+
+    Fl_Double_Window win(m_win->x(), m_win->y(), 400, 44, "Verifying game files");
+    Fl_Progress *bar = new Fl_Progress(10, 10, win.w() - 20, 24);
+    bar->minimum(0);
+    bar->maximum(1);
+    bar->selection_color(MARATHON_BLUE);
+    bar->labelsize(12);
+    win.end();
+    win.callback([] (Fl_Widget *) {});  /* can't be cancelled */
+    win.show();
+
+    /* files() must not change while it's read below */
+    v.prepare();
+
+    std::atomic<bool> finished(false);
+    std::thread t([&] () {
+        v.run();
+        finished = true;
+    });
+
+    char buf[64];
+
+    while (!finished) {
+        snprintf(buf, sizeof(buf), "%zu of %zu files", v.done.load(), v.files());
+        bar->label(buf);
+        bar->value(v.files() ? static_cast<float>(v.done) / v.files() : 0);
+        bar->redraw();
+        Fl::wait(0.1);
+    }
 
-        /* always ask when using a custom script */
-        if (fl_ask("%s\n\n>> %s", msg, m_script) == 0) {
-            return false;
-        }
+    t.join();
+    win.hide();
+    cache.save(cachefile);
 
-        sprintf(buf, fmt, m_win->x_root(), m_win->y_root());
-        s = std::string(buf) + "sh -c " + m_script;
-        s += " ; set +x; echo; echo \"Press ENTER to close window\"; read x'";
-        command(s.c_str());
+    LOG("verify: %zu files, %zu hashed (%.1f MiB)", v.files(), v.hashed.load(), v.bytes / (1024.0*1024.0));
 
+    if (v.ok()) {
+        fl_message_title("Verify");
+        fl_message("All %zu files are intact.", v.files());
         return true;
     }
 
-    /* check for curl or wget */
-    if (command("wget --version 2>/dev/null >/dev/null") != 0) {
-        error_message("`wget' is required to download the game files.");
+    /* list some of the damaged files */
+    std::string s = "The following files are missing or damaged:\n";
+    int listed = 0;
+
+    for (const auto &r : v.results()) {
+        for (const auto *list : { &r.missing, &r.corrupt }) {
+            for (const auto &name : *list) {
+                if (listed++ < 10) s += "\n" + name;
+            }
+        }
+    }
+
+    if (listed > 10) {
+        s += "\n... and " + std::to_string(listed - 10) + " more";
+    }
+
+    fl_message_title("Verify");
+
+    if (fl_choice("%s\n\nDo you want to download them again?", "No", "Yes", NULL, s.c_str()) != 1) {
         return false;
     }
 
-    /* ask the user if they want to download everything again */
-    if (all_directories_exist()) {
-        fl_message_title("Download again?");
+    /* forget about the damaged files so the update fetches them again */
+    for (const auto &r : v.results()) {
+        manifest m;
+        const std::string path = r.dir + ".manifest";
 
-        if (fl_ask("%s", "Do you want to re-download the game files?") == 0) {
-            return false;
+        if (!m.load(path)) continue;
+
+        for (const auto *list : { &r.missing, &r.corrupt }) {
+            for (const auto &name : *list) {
+                m.erase(name);
+            }
         }
+
+        m.save(path);
     }
 
-    /* delete existing data directories */
-    if (!remove_data("data-marathon-master")) return false;
-    if (!remove_data("data-marathon-2-master")) return false;
-    if (!remove_data("data-marathon-infinity-master")) return false;
+    Fl::hide_all_windows();
+    update();
+    m_win->show();
 
-    /* delete icon */
-    s = confdir() + "alephone.png";
-    LOG("delete: %s", s.c_str());
-    remove(s.c_str());
+    return false;
+}
 
-#define ICON_URL "https://raw.githubusercontent.com/Aleph-One-Marathon/alephone/5653d64ba12f2cf058abcd8fd9ec2f06bcae9839/flatpak/alephone.png"
-#define REPO "https://github.com/Aleph-One-Marathon/data-marathon"
-#define MARATHON_DL(x) "(wget -O- " REPO x "/archive/refs/heads/master.tar.gz | tar xfz - -C ~/.alephone)"
-
-    const char *default_script =
-        "set -x;"
-        "("
-            /* ignore error on icon download but not on game data */
-            "wget -O ~/.alephone/alephone.png " ICON_URL " ;"
-            MARATHON_DL("") " && "
-            MARATHON_DL("-2") " && "
-            MARATHON_DL("-infinity")
-        ") || ("
-            "set +x;"
-            "echo;"
-            "echo \"Press ENTER to close window\";"
-            "read x"
-        ")"
-        "'";
-
-    /* run command */
-    sprintf(buf, fmt, m_win->x_root(), m_win->y_root());
-    s = std::string(buf) + default_script;
-    command(s.c_str());
+/* same as verify() but without GUI; returns the exit code */
+int launcher::verify_cli()
+{
+    TRACE_SCOPE("verify");
+    const char *home = getenv("HOME");
 
-    return true;
+    if (!home) {
+        fprintf(stderr, "error: HOME is not set\n");
+        return 1;
+    }
+
+    const std::string confdir = std::string(home) + "/.alephone/";
+    const std::string cachefile = confdir + "hashcache";
+    hash_cache cache;
+    verifier v(cache);
+    catalog cat;
+
+    read_catalog(cat, confdir);
+
+    if (add_games(v, cat, confdir) == 0) {
+        fprintf(stderr, "error: no file lists found, please download the game files first\n");
+        return 1;
+    }
+
+    cache.load(cachefile);
+    v.run();
+    cache.save(cachefile);
+
+    for (const auto &r : v.results()) {
+        for (const auto &name : r.missing) {
+            printf("missing: %s/%s\n", r.dir.c_str(), name.c_str());
+        }
+
+        for (const auto &name : r.corrupt) {
+            printf("damaged: %s/%s\n", r.dir.c_str(), name.c_str());
+        }
+    }
+
+    printf("%zu files checked, %zu hashed (%.1f MiB): %s\n", v.files(), v.hashed.load(),
+        v.bytes / (1024.0*1024.0), v.ok() ? "OK" : "FAILED");
+
+    return v.ok() ? 0 : 1;
 }
 
 /* returns resolved path to executable + ".png" */
@@ -432,29 +1980,55 @@ void launcher::download_cb(Fl_Widget *o, void *p)
 {
     launcher *l = reinterpret_cast<launcher *>(p);
     Fl::hide_all_windows();
+
+    /* the script runs in the background */
+    if (l->m_script) {
+        if (!l->download_script()) o->window()->show();
+        return;
+    }
+
     if (l->download()) l->load_default_icon();
     o->window()->show();
 }
 
-/* start a Marathon game; "alephone" is expected to be in PATH */
+/* the "verify" button was clicked */
+void launcher::verify_cb(Fl_Widget *, void *p)
+{
+    reinterpret_cast<launcher *>(p)->verify();
+}
+
+/* start a Marathon game; "alephone" is expected to be in PATH;
+ * the launcher is hidden until the game has exited */
 void launcher::launch_cb(Fl_Widget *o, void *p)
 {
-    Fl::hide_all_windows();
+    launcher *l = reinterpret_cast<launcher *>(p);
+    const int i = static_cast<logobutton *>(o)->entry();
 
-    if (command((const char *)p) != 0 &&
-        command("alephone --version 2>/dev/null >/dev/null") != 0)
-    {
+    auto done = [l] (int) {
+        l->m_win->show();
+    };
+
+    if (!l->find_engine()) {
         error_message("`alephone' is not in PATH");
+        return;
     }
 
-    o->window()->show();
+    Fl::hide_all_windows();
+
+    if (!l->spawn({ l->m_engine->path(), l->data_dir(i) }, false, done)) {
+        error_message("cannot start `alephone'");
+        l->m_win->show();
+    }
 }
 
 /* create a window but don't show() it yet */
 void launcher::make_window(bool system_colors)
 {
+    TRACE_SCOPE("make_window");
     Fl_Widget *o;
     const int y = 220;
+    const int count = m_catalog->size();
+    const int rows = (count < LIST_ROWS) ? count : LIST_ROWS;
 
     if (system_colors) {
         Fl::get_system_colors();
@@ -467,46 +2041,51 @@ void launcher::make_window(bool system_colors)
     Fl::scheme("gtk+");
 
     /* window begin */
-    m_win = new launcher_window(234, 145+y, this, "Marathon Launcher");
+    m_win = new launcher_window(234, 55+30*rows+y, this, "Marathon Launcher");
     m_win->begin();
 
     /* Aleph One logo */
-    m_cirlce_o1 = new circle((m_win->w() - 200)/2, 10, 200, MARATHON_GREEN);
-    new circle((m_win->w() - 130)/2, 18, 130, m_win->color());
-    m_cirlce_o2 = new circle((m_win->w() - 105)/2, 30, 105, MARATHON_GREEN);
-    new Fl_Box(FL_FLAT_BOX, (m_win->w() - 20)/2, 145, 20, 66, NULL);
+    m_logo = new logobox((m_win->w() - 200)/2, 10,
+        { MARATHON_GREEN, MARATHON_BLUE, MARATHON_YELLOW, MARATHON_GRAY });
 
     /* set this above the logo but below the buttons */
     new movebox(0, 0, m_win->w(), m_win->h());
 
-    /* Marathon Trilogy */
-    o = new logobutton(10, y, m_win->w()-20, 30, MARATHON_BLUE, this, "Marathon");
-    o->callback(launch_cb, (void *)"alephone ~/.alephone/data-marathon-master");
+    /* games and scenarios; only the visible rows are created */
+    m_list = new gamelist(10, y, m_win->w()-20, 30, rows, count, this);
 
-    o = new logobutton(10, 30+y, m_win->w()-20, 30, MARATHON_YELLOW, this, "Marathon 2: Durandal");
-    o->callback(launch_cb, (void *)"alephone ~/.alephone/data-marathon-2-master");
+    for (logobutton *b : m_list->buttons()) {
+        b->callback(launch_cb, this);
+    }
 
-    o = new logobutton(10, 60+y, m_win->w()-20, 30, MARATHON_GRAY, this, "Marathon Infinity");
-    o->callback(launch_cb, (void *)"alephone ~/.alephone/data-marathon-infinity-master");
+    update_buttons();
 
-    const int w2 = (m_win->w() - 20) / 2;
+    const int w3 = (m_win->w() - 20) / 3;
     const int y2 = m_win->h() - 40;
 
     /* Download Files */
-    o = new Fl_Button(10, y2, w2-1, 30, "Download Files");
+    o = new Fl_Button(10, y2, w3-1, 30, "Download");
     o->box(BOXTYPE);
     o->labelsize(13);
+    o->tooltip("Download or update the game files");
     o->callback(download_cb, this);
 
+    /* Verify Files */
+    o = new Fl_Button(w3+10, y2, w3-1, 30, "Verify");
+    o->box(BOXTYPE);
+    o->labelsize(13);
+    o->tooltip("Check the installed game files for damage");
+    o->callback(verify_cb, this);
+
     /* Github */
-    auto github_cb = [] (Fl_Widget *) {
-        command("xdg-open https://github.com/Aleph-One-Marathon 2>/dev/null >/dev/null");
+    auto github_cb = [] (Fl_Widget *, void *p) {
+        reinterpret_cast<launcher *>(p)->spawn({ "xdg-open", "https://github.com/Aleph-One-Marathon" }, true);
     };
 
-    o = new Fl_Button(w2+11, y2, w2, 30, "Visit Github");
+    o = new Fl_Button(2*w3+10, y2, m_win->w() - 2*w3 - 20, 30, "Github");
     o->box(BOXTYPE);
     o->labelsize(13);
-    o->callback(github_cb);
+    o->callback(github_cb, this);
 
     /* window end */
     m_win->end();
@@ -516,20 +2095,34 @@ void launcher::make_window(bool system_colors)
     m_win->position((Fl::w() - m_win->decorated_w()) / 2, (Fl::h() - m_win->decorated_h()) / 2);
 }
 
-/* load icon and show() the window */
+/* start loading the icon and show() the window */
 int launcher::run()
 {
     load_default_icon();
-    m_win->show();
+    scan_scenarios();
+
+    {
+        TRACE_SCOPE("show");
+        m_win->show();
+    }
+
     LOG("PID: %d\nXID: 0x%08lx", getpid(), fl_x11_xid(m_win));
-    return Fl::run();
+
+    /* same as Fl::run() but don't quit while the
+     * window is hidden for a running child process */
+    while (Fl::first_window() || !m_children.empty()) {
+        Fl::wait(1e20);
+    }
+
+    return 0;
 }
 
 static void print_help(const char *argv0)
 {
     const char *msg =
         "usage: %s --help\n"
-        "       %s [--verbose] [--download-script=SCRIPT] "
+        "       %s --verify [--verbose] [--trace=FILE]\n"
+        "       %s [--verbose] [--trace=FILE] [--download-script=SCRIPT] [--repack] "
 #ifdef DEFAULT_SYSTEM_COLORS
             "[--no-system-colors]\n"
 #else
@@ -539,6 +2132,17 @@ static void print_help(const char *argv0)
         "SCRIPT must be a shell script that downloads the game data into the\n"
         "directories listed below.\n"
         "\n"
+        "--verify checks the installed game files against their file lists\n"
+        "and exits with a non-zero status if files are missing or damaged.\n"
+        "\n"
+        "--trace=FILE writes the time spent in startup phases, downloads and\n"
+        "child processes to FILE in Chrome trace-event format, which can be\n"
+        "viewed with https://ui.perfetto.dev\n"
+        "\n"
+        "--repack additionally stores downloaded archives in the cache as\n"
+        "packs that are extracted on all CPU cores when they're installed\n"
+        "again; existing packs are always used.\n"
+        "\n"
         "\n"
         "Aleph One config directory:\n"
         "  ~/.alephone\n"
@@ -548,12 +2152,58 @@ static void print_help(const char *argv0)
         "  Marathon 2:         ~/.alephone/data-marathon-2-master\n"
         "  Marathon Infinity:  ~/.alephone/data-marathon-infinity-master\n"
         "\n"
-        "Download log file:\n"
+        "More games and scenarios can be listed in ~/.alephone/catalog,\n"
+        "one section per entry:\n"
+        "  [Marathon Rubicon X]\n"
+        "  dir=rubicon-x                          (inside of ~/.alephone)\n"
+        "  url=https://example.org/rubicon-x.tar.gz  (optional)\n"
+        "  repo=owner/name                        (Github, optional)\n"
+        "  color=#c03020                          (optional)\n"
+        "The top-level directory of the archive must be named like \"dir\".\n"
+        "\n"
+        "Scenarios (directories with Map and Shapes files) are also searched\n"
+        "in ~/.alephone, $XDG_DATA_HOME/AlephOne and <$XDG_DATA_DIRS>/AlephOne;\n"
+        "the directories that were read are remembered in:\n"
+        "  ~/.alephone/scenarios\n"
+        "\n"
+        "Interrupted downloads are resumed from:\n"
+        "  ~/.alephone/data-marathon*-master.tar.gz.part\n"
+        "\n"
+        "New game data is extracted into this directory first:\n"
+        "  ~/.alephone/staging\n"
+        "\n"
+        "Old game data is deleted in the background from:\n"
+        "  ~/.alephone/trash.*\n"
+        "\n"
+        "Archive cache (*.tar.gz, *.pack with --repack):\n"
+        "  ~/.alephone/cache\n"
+        "\n"
+        "File lists used to update and verify the game data:\n"
+        "  ~/.alephone/data-marathon*-master.manifest\n"
+        "  ~/.alephone/hashcache\n"
+        "\n"
+        "Alternative servers for downloads, probed for the fastest one:\n"
+        "  ~/.alephone/mirrors\n"
+        "  [https://github.com/]                  (origin URL prefix)\n"
+        "  mirror=http://mirror.lan/github/       (same files below this prefix)\n"
+        "\n"
+        "After a download, identical files of all games are reflinked (or\n"
+        "hard linked and made read-only); their hashes are remembered in:\n"
+        "  ~/.alephone/dedupecache\n"
+        "\n"
+        "Location and version of the alephone executable:\n"
+        "  ~/.alephone/engine\n"
+        "\n"
+        "Install state of the game directories:\n"
+        "  ~/.alephone/installed\n"
+        "\n"
+        "Download log files (custom script), older runs are rotated:\n"
         "  ~/.alephone/download.log\n"
+        "  ~/.alephone/download.log.[1-3]\n"
         "\n"
         "Icon lookup paths:\n";
 
-    printf(msg, argv0, argv0);
+    printf(msg, argv0, argv0, argv0);
 
     std::string self = launcher::get_self_exe_png();
 
@@ -563,7 +2213,10 @@ static void print_help(const char *argv0)
 
     puts("  ~/.alephone/alephone.png  (will be overwritten on new game downloads)\n"
         "  /usr/share/icons/hicolor/<...>/apps/alephone.png\n"
-        "  /usr/share/pixmaps/alephone.png\n");
+        "  /usr/share/pixmaps/alephone.png\n"
+        "\n"
+        "The icon that was found last time is remembered in:\n"
+        "  ~/.alephone/icon\n");
 
     launcher::print_fltk_version();
 }
@@ -577,7 +2230,9 @@ int main(int argc, char **argv)
 #endif
 
     bool arg_verbose = false;
+    bool arg_verify = false;
     const char *arg_script = NULL;
+    bool arg_repack = false;
 
     for (int i=1; i < argc; i++) {
         if (strcmp(argv[i], "--help") == 0) {
@@ -585,8 +2240,17 @@ int main(int argc, char **argv)
             return 0;
         } else if (strcmp(argv[i], "--verbose") == 0) {
             arg_verbose = true;
+        } else if (strcmp(argv[i], "--verify") == 0) {
+            arg_verify = true;
+        } else if (strncmp(argv[i], "--trace=", 8) == 0) {
+            if (!trace_open(argv[i] + 8)) {
+                fprintf(stderr, "cannot write trace file: %s\n", argv[i] + 8);
+            }
+            trace_instant("main");
         } else if (strncmp(argv[i], "--download-script=", 18) == 0) {
             arg_script = argv[i] + 18;
+        } else if (strcmp(argv[i], "--repack") == 0) {
+            arg_repack = true;
 #ifdef DEFAULT_SYSTEM_COLORS
         } else if (strcmp(argv[i], "--no-system-colors") == 0) {
 #else
@@ -598,9 +2262,17 @@ int main(int argc, char **argv)
         }
     }
 
+    /* the constructor already logs */
+    launcher::verbose(arg_verbose);
+
+    /* doesn't need a window */
+    if (arg_verify) {
+        return launcher::verify_cli();
+    }
+
     launcher l(arg_system_colors);
-    l.verbose(arg_verbose);
     l.script(arg_script);
+    l.repack(arg_repack);
 
     return l.run();
 }
@@ -26,15 +26,25 @@
 #define LAUNCHER_HPP
 
 #include <FL/Fl.H>
-#include <FL/Fl_Box.H>
 #include <FL/Fl_Button.H>
 #include <FL/Fl_Double_Window.H>
+#include <FL/Fl_Group.H>
 #include <FL/Fl_PNG_Image.H>
+#include <FL/Fl_Scrollbar.H>
+#include <FL/Fl_Text_Buffer.H>
+#include <FL/Fl_Text_Display.H>
 #include <FL/fl_draw.H>
+#include <functional>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
 
 /* disable "deprecated" warning for fl_ask :-) */
 //#include <FL/fl_ask.H>
 extern int fl_ask(const char *, ...) __fl_attr((__format__(__printf__, 1, 2)));
+extern int fl_choice(const char *, const char *, const char *, const char *, ...) __fl_attr((__format__(__printf__, 1, 5)));
 extern void fl_alert(const char *, ...) __fl_attr((__format__(__printf__, 1, 2)));
 extern void fl_message(const char *, ...) __fl_attr((__format__(__printf__, 1, 2)));
 extern void fl_message_title(const char *title);
@@ -46,42 +56,67 @@ extern void fl_message_title(const char *title);
 
 #define BOXTYPE FL_THIN_UP_BOX
 
-class circle;
+class logobox;
 class movebox;
 class logobutton;
+class gamelist;
+class logview;
 class launcher_window;
 class launcher;
-
-
-/* simple class to draw circles;
- * used to create the Marathon logo */
-class circle : public Fl_Widget
+class download_pool;
+class install_index;
+class child_process;
+class prefetcher;
+class engine_info;
+class icon_loader;
+class hash_cache;
+class file_deduper;
+class catalog;
+class scenario_scanner;
+class log_buffer;
+
+
+/* the Aleph One logo (two rings and a bar); every color is drawn only
+ * once into an offscreen buffer, so changing the color just copies
+ * the pixels of the logo's area to the window */
+class logobox : public Fl_Widget
 {
 private:
-    int m_d = 0;
+
+    struct cache_entry
+    {
+        Fl_Color color;
+        Fl_Offscreen buf;
+    };
+
+    std::vector<Fl_Color> m_colors;
+    std::vector<cache_entry> m_cache;
+
+    Fl_Offscreen render(Fl_Color col);
 
 public:
 
-    circle(int X, int Y, int D, Fl_Color C)
-    : Fl_Widget(X,Y,0,0), m_d(D)
+    /* all of <colors> are rendered on the first draw; the first one
+     * is the initial color */
+    logobox(int X, int Y, const std::vector<Fl_Color> &colors)
+    : Fl_Widget(X,Y,200,201), m_colors(colors)
     {
-        color(C);
+        color(colors.at(0));
     }
 
-    virtual ~circle() {}
+    virtual ~logobox();
 
-protected:
+    /* only damages the area of the logo */
+    void logo_color(Fl_Color col);
 
-    int d() const {return m_d;}
+protected:
 
-    void draw() {
-        fl_color(color());
-        fl_draw_circle(x(), y(), d(), color());
-    }
+    void draw();
 };
 
 /* simple class that allows to move the
- * window when clicked on it */
+ * window when clicked on it; drag events are
+ * coalesced to one move per display frame */
 class movebox : public Fl_Widget
 {
 private:
@@ -89,6 +124,18 @@ private:
     int m_event_x = 0;
     int m_event_y = 0;
 
+    /* latest position that was not applied yet */
+    int m_move_x = 0;
+    int m_move_y = 0;
+    bool m_pending = false;
+
+    /* statistics of the current drag */
+    unsigned m_drags = 0;
+    unsigned m_moves = 0;
+
+    void move();
+    static void move_cb(void *p);
+
 public:
 
     movebox(int X, int Y, int W, int H)
@@ -111,6 +158,7 @@ private:
 
     Fl_Color m_col = MARATHON_GREEN;
     launcher *m_l = NULL;
+    int m_entry = -1;
 
 public:
 
@@ -123,12 +171,77 @@ public:
 
     virtual ~logobutton() {}
 
+    /* catalog entry shown by this button */
+    int entry() const {return m_entry;}
+    void entry(int i) {m_entry = i;}
+
+    void hover_color(Fl_Color col);
+
 private:
 
     int handle(int e);
     void set_color(Fl_Color col);
 };
 
+/* Scrolling list of catalog entries. Only the visible rows have a
+ * button; scrolling assigns other entries to the same buttons and
+ * lets the launcher update their labels. */
+class gamelist : public Fl_Group
+{
+private:
+
+    launcher *m_l = NULL;
+    Fl_Scrollbar *m_bar = NULL;
+    std::vector<logobutton *> m_rows;
+    int m_count = 0;
+    int m_top = 0;
+
+    static void scroll_cb(Fl_Widget *o, void *p);
+
+public:
+
+    /* <rows> buttons of <row_h> pixels height for <count> entries */
+    gamelist(int X, int Y, int W, int row_h, int rows, int count, launcher *o);
+
+    virtual ~gamelist() {}
+
+    /* show entry <top> in the first row */
+    void scroll_to(int top);
+
+    /* the number of entries changed; adds a scrollbar if needed */
+    void count(int n);
+
+    const std::vector<logobutton *> &buttons() const {return m_rows;}
+
+protected:
+
+    int handle(int e);
+};
+
+/* Shows the end of a log_buffer. New output is picked up by a timer,
+ * so the display is redrawn at most a few times per second no matter
+ * how fast the log is written; old lines are removed to keep the
+ * text below <max> bytes. */
+class logview : public Fl_Text_Display
+{
+private:
+
+    Fl_Text_Buffer *m_text = NULL;
+    const log_buffer *m_log = NULL;
+    uint64_t m_seq = 0;
+    size_t m_max;
+    bool m_cr = false;
+
+    static void update_cb(void *p);
+
+public:
+
+    logview(int X, int Y, int W, int H, const log_buffer *log, size_t max);
+    virtual ~logview();
+
+    void update();
+};
+
 /* subclass of Fl_Double_Window that sets the Marathon logo color
  * back to normal when re-entering the window */
 class launcher_window : public Fl_Double_Window
@@ -136,6 +249,7 @@ class launcher_window : public Fl_Double_Window
 private:
 
     launcher *m_l = NULL;
+    bool m_drawn = false;
 
 public:
 
@@ -148,6 +262,7 @@ public:
 private:
 
     int handle(int e);
+    void draw();
 };
 
 /* the launcher application */
@@ -157,12 +272,42 @@ private:
 
     const char *m_home = NULL;
     Fl_PNG_Image *m_png = NULL;
+    std::vector<Fl_RGB_Image *> m_fallback_icons;
     Fl_Double_Window *m_win = NULL;
-    circle *m_cirlce_o1 = NULL;
-    circle *m_cirlce_o2 = NULL;
+    logobox *m_logo = NULL;
+    catalog *m_catalog = NULL;
+    gamelist *m_list = NULL;
+    scenario_scanner *m_scan = NULL;
+    install_index *m_index = NULL;
+    prefetcher *m_prefetch = NULL;
+    engine_info *m_engine = NULL;
+    icon_loader *m_icon = NULL;
+    std::string m_engine_tooltip;
+    bool m_engine_probing = false;
+    std::vector<std::future<void>> m_cleanup;
+
+    /* the running dedupe() pass */
+    std::future<void> m_dedupe;
+    hash_cache *m_dedupe_cache = NULL;
+    file_deduper *m_deduper = NULL;
+
+    struct child
+    {
+        child_process *proc;
+        std::function<void (int status)> done;
+    };
+
+    std::vector<child> m_children;
+
+    /* output of the custom download script */
+    log_buffer *m_log = NULL;
+    Fl_Double_Window *m_logwin = NULL;
+    child_process *m_script_proc = NULL;
+    int m_log_fd = -1;
 
     static bool m_verbose;
     const char *m_script = NULL;
+    bool m_repack = false;
 
     void make_window(bool system_colors);
 
@@ -176,39 +321,76 @@ public:
          * m_win before anything else */
         m_home = getenv("HOME");
         print_fltk_version();
+        load_catalog();
+        load_scenarios();
+        load_index();
+        remove_trash();
+        find_engine();
         make_window(system_colors);
     }
 
-    ~launcher() {
-        if (m_win) delete m_win;
-        if (m_png) delete m_png;
-    }
+    ~launcher();
 
     int run();
     bool download();
 
     void script(const char *p);
-    circle *logo1() const {return m_cirlce_o1;}
-    circle *logo2() const {return m_cirlce_o2;}
+    void repack(bool b) {m_repack = b;}
+    logobox *logo() const {return m_logo;}
+
+    void prefetch(const logobutton *o);
 
-    void verbose(bool b) {m_verbose = b;}
+    /* set label, colors and tooltip of all visible game buttons */
+    void update_buttons();
+
+    static void verbose(bool b) {m_verbose = b;}
     static bool verbose() {return m_verbose;}
 
+    static int verify_cli();
+
     static std::string get_self_exe_png();
 
 private:
 
     static void error_message(const char *msg);
-    static int command(const char *cmd);
 
     std::string confdir() const;
     void load_default_icon();
-    bool default_icon_png(const char *path);
+    void load_fallback_icon();
     bool all_directories_exist();
-    bool is_full_directory(const char *path);
-    bool remove_data(const char *dir);
-
+    bool all_manifests_exist();
+    void load_catalog();
+    void load_scenarios();
+    void scan_scenarios();
+    bool add_scenario(const std::string &path);
+    std::string data_dir(size_t i) const;
+    void load_index();
+    void watch_index();
+    void move_to_trash(const std::string &path);
+    void remove_trash();
+    void dedupe();
+    void stop_dedupe();
+    bool install_staged(const std::string &staging, int i);
+    child_process *spawn(const std::vector<std::string> &argv, bool quiet,
+                         std::function<void (int status)> done = nullptr,
+                         int out = -1, int err = -1, bool group = false);
+    bool find_engine();
+    void probe_engine();
+    bool download_script();
+    void read_log();
+    void close_log();
+    bool transfer(download_pool &pool);
+    bool update();
+    bool verify();
+
+    static void index_cb(int fd, void *p);
+    static void child_cb(int fd, void *p);
+    static void icon_cb(int fd, void *p);
+    static void log_cb(int fd, void *p);
+    static void logwin_cb(Fl_Widget *o, void *p);
+    static void scan_cb(int fd, void *p);
     static void download_cb(Fl_Widget *o, void *p);
+    static void verify_cb(Fl_Widget *o, void *p);
     static void launch_cb(Fl_Widget *o, void *p);
 };
 
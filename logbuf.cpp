@@ -0,0 +1,208 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "logbuf.hpp"
+
+
+bool log_buffer::open(const std::string &path, uint64_t segment, int keep)
+{
+    close();
+
+    m_path = path;
+    m_segment = segment;
+    m_keep = keep;
+
+    /* every run starts a new segment */
+    rotate();
+
+    if (!m_fp) return false;
+
+    m_stop = false;
+    m_thread = std::thread(&log_buffer::writer, this);
+
+    return true;
+}
+
+void log_buffer::close()
+{
+    if (m_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+            m_cond.notify_one();
+        }
+
+        m_thread.join();
+    }
+
+    if (m_fp) {
+        fclose(m_fp);
+        m_fp = NULL;
+    }
+}
+
+/* "<path>" -> "<path>.1" -> ... -> "<path>.<keep>"; opens a new "<path>" */
+void log_buffer::rotate()
+{
+    if (m_fp) fclose(m_fp);
+
+    for (int i = m_keep; i > 0; i--) {
+        std::string from = m_path;
+        if (i > 1) from += "." + std::to_string(i - 1);
+        rename(from.c_str(), (m_path + "." + std::to_string(i)).c_str());
+    }
+
+    m_fp = fopen(m_path.c_str(), "we");
+    m_written = 0;
+}
+
+void log_buffer::writer()
+{
+    std::string buf;
+
+    for (;;) {
+        uint64_t dropped;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [this] {return m_stop || !m_pending.empty();});
+
+            if (m_pending.empty() && m_stop) {
+                return;
+            }
+
+            buf.swap(m_pending);
+            dropped = m_dropped;
+            m_dropped = 0;
+        }
+
+        if (!m_fp) {
+            buf.clear();
+            continue;
+        }
+
+        if (dropped > 0) {
+            m_written += fprintf(m_fp, "\n[... %llu bytes not logged ...]\n",
+                static_cast<unsigned long long>(dropped));
+        }
+
+        m_written += fwrite(buf.data(), 1, buf.size(), m_fp);
+        fflush(m_fp);
+        buf.clear();
+
+        if (m_segment > 0 && m_written >= m_segment) {
+            rotate();
+        }
+    }
+}
+
+void log_buffer::append(const char *buf, size_t len)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const size_t cap = m_ring.size();
+
+    /* only the end can be kept */
+    const char *p = buf;
+    size_t n = len;
+
+    if (n > cap) {
+        p += n - cap;
+        n = cap;
+    }
+
+    size_t pos = (m_total + (len - n)) % cap;
+
+    while (n > 0) {
+        const size_t chunk = std::min(n, cap - pos);
+        std::copy(p, p + chunk, m_ring.begin() + pos);
+        p += chunk;
+        n -= chunk;
+        pos = 0;
+    }
+
+    m_total += len;
+
+    if (!m_thread.joinable()) {
+        return;
+    }
+
+    /* the pending data is bounded by the ring size as well */
+    if (m_pending.size() + len > cap) {
+        m_dropped += len;
+    } else {
+        m_pending.append(buf, len);
+    }
+
+    m_cond.notify_one();
+}
+
+void log_buffer::print(const char *fmt, ...)
+{
+    char buf[1024];
+    va_list ap;
+
+    va_start(ap, fmt);
+    int len = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+
+    if (len < 0) return;
+    if (len >= static_cast<int>(sizeof(buf))) len = sizeof(buf) - 1;
+
+    append(buf, len);
+}
+
+uint64_t log_buffer::total() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_total;
+}
+
+uint64_t log_buffer::read(uint64_t &seq, std::string &out) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const size_t cap = m_ring.size();
+    const uint64_t first = (m_total > cap) ? m_total - cap : 0;
+    uint64_t lost = 0;
+
+    if (seq < first) {
+        lost = first - seq;
+        seq = first;
+    }
+
+    while (seq < m_total) {
+        const size_t pos = seq % cap;
+        const size_t chunk = std::min<uint64_t>(m_total - seq, cap - pos);
+        out.append(m_ring.data() + pos, chunk);
+        seq += chunk;
+    }
+
+    return lost;
+}
@@ -0,0 +1,97 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef LOGBUF_HPP
+#define LOGBUF_HPP
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+#include <stdio.h>
+
+class log_buffer;
+
+
+/* Keeps the last <capacity> bytes of a log in a ring buffer, so memory
+ * stays bounded no matter how much is written. If a file was opened,
+ * everything is also written to it by a background thread; once the
+ * file has reached the segment size it's rotated to "<path>.1" (and
+ * "<path>.1" to "<path>.2" and so on). Output the writer can't keep up
+ * with is dropped and replaced by a note. */
+class log_buffer
+{
+private:
+
+    mutable std::mutex m_mutex;
+
+    /* ring buffer; m_total bytes were appended in total */
+    std::vector<char> m_ring;
+    uint64_t m_total = 0;
+
+    /* not written to the file yet */
+    std::string m_pending;
+    uint64_t m_dropped = 0;
+
+    std::condition_variable m_cond;
+    std::thread m_thread;
+    bool m_stop = false;
+
+    std::string m_path;
+    FILE *m_fp = NULL;
+    uint64_t m_written = 0;
+    uint64_t m_segment = 0;
+    int m_keep = 0;
+
+    void writer();
+    void rotate();
+
+public:
+
+    log_buffer(size_t capacity = 256*1024)
+    : m_ring(capacity)
+    {}
+
+    ~log_buffer() {close();}
+
+    /* start writing to <path>; an existing file is rotated first */
+    bool open(const std::string &path, uint64_t segment = 1024*1024, int keep = 3);
+
+    /* write out everything that is pending and stop the writer */
+    void close();
+
+    void append(const char *buf, size_t len);
+    void print(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+    uint64_t total() const;
+
+    /* Get everything that was appended after the first <seq> bytes and is
+     * still in the ring buffer; <seq> is advanced to total(). Returns the
+     * number of bytes that were lost because they were overwritten. */
+    uint64_t read(uint64_t &seq, std::string &out) const;
+};
+
+#endif /* LOGBUF_HPP */
@@ -0,0 +1,355 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "manifest.hpp"
+
+#define MANIFEST_MAGIC  "# marathon-game-launcher manifest 1"
+
+
+bool manifest_safe_path(const std::string &path)
+{
+    if (path.empty() || path[0] == '/') {
+        return false;
+    }
+
+    for (size_t pos = 0; pos <= path.size(); ) {
+        size_t end = path.find('/', pos);
+        if (end == std::string::npos) end = path.size();
+
+        const std::string c = path.substr(pos, end - pos);
+
+        if (c.empty() || c == "." || c == "..") {
+            return false;
+        }
+
+        pos = end + 1;
+    }
+
+    return true;
+}
+
+
+/* just enough of a JSON reader to walk through GitHub API responses */
+class json_reader
+{
+private:
+
+    const char *m_p;
+    const char *m_end;
+
+public:
+
+    json_reader(const std::string &s)
+    : m_p(s.data()), m_end(s.data() + s.size())
+    {}
+
+    void ws() {
+        while (m_p < m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r')) m_p++;
+    }
+
+    bool peek(char c) {
+        ws();
+        return (m_p < m_end && *m_p == c);
+    }
+
+    bool next(char c) {
+        if (!peek(c)) return false;
+        m_p++;
+        return true;
+    }
+
+    bool string(std::string &out);
+    bool scalar(std::string &out);
+    bool skip();
+};
+
+static void utf8_append(std::string &s, unsigned long c)
+{
+    if (c < 0x80) {
+        s += static_cast<char>(c);
+    } else if (c < 0x800) {
+        s += static_cast<char>(0xC0 | (c >> 6));
+        s += static_cast<char>(0x80 | (c & 0x3F));
+    } else if (c < 0x10000) {
+        s += static_cast<char>(0xE0 | (c >> 12));
+        s += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+        s += static_cast<char>(0x80 | (c & 0x3F));
+    } else {
+        s += static_cast<char>(0xF0 | (c >> 18));
+        s += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+        s += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+        s += static_cast<char>(0x80 | (c & 0x3F));
+    }
+}
+
+bool json_reader::string(std::string &out)
+{
+    if (!next('"')) return false;
+    out.clear();
+
+    while (m_p < m_end && *m_p != '"') {
+        if (*m_p != '\\') {
+            out += *m_p++;
+            continue;
+        }
+
+        if (++m_p >= m_end) return false;
+
+        switch (*m_p) {
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                if (m_end - m_p < 5) return false;
+                unsigned long c = strtoul(std::string(m_p + 1, 4).c_str(), NULL, 16);
+                m_p += 4;
+
+                /* surrogate pair */
+                if (c >= 0xD800 && c < 0xDC00 && m_end - m_p > 6 && m_p[1] == '\\' && m_p[2] == 'u') {
+                    unsigned long lo = strtoul(std::string(m_p + 3, 4).c_str(), NULL, 16);
+                    c = 0x10000 + ((c - 0xD800) << 10) + (lo - 0xDC00);
+                    m_p += 6;
+                }
+
+                utf8_append(out, c);
+                break;
+            }
+            default:
+                out += *m_p;
+                break;
+        }
+
+        m_p++;
+    }
+
+    return next('"');
+}
+
+/* number, true, false or null */
+bool json_reader::scalar(std::string &out)
+{
+    ws();
+    const char *p = m_p;
+
+    while (m_p < m_end && strchr(",}] \t\r\n", *m_p) == NULL) {
+        m_p++;
+    }
+
+    out.assign(p, m_p - p);
+
+    return !out.empty();
+}
+
+bool json_reader::skip()
+{
+    std::string s;
+
+    if (peek('"')) {
+        return string(s);
+    } else if (next('{')) {
+        if (next('}')) return true;
+
+        do {
+            if (!string(s) || !next(':') || !skip()) return false;
+        } while (next(','));
+
+        return next('}');
+    } else if (next('[')) {
+        if (next(']')) return true;
+
+        do {
+            if (!skip()) return false;
+        } while (next(','));
+
+        return next(']');
+    }
+
+    return scalar(s);
+}
+
+
+bool manifest::load(const std::string &path)
+{
+    FILE *fp = fopen(path.c_str(), "re");
+    if (!fp) return false;
+
+    char line[4096];
+    m_files.clear();
+
+    if (!fgets(line, sizeof(line), fp) || strncmp(line, MANIFEST_MAGIC, strlen(MANIFEST_MAGIC)) != 0) {
+        fclose(fp);
+        return false;
+    }
+
+    /* "<sha1> <size> <path>" */
+    while (fgets(line, sizeof(line), fp)) {
+        line[strcspn(line, "\n")] = 0;
+
+        char *p1 = strchr(line, ' ');
+        if (!p1) continue;
+
+        char *p2 = strchr(p1 + 1, ' ');
+        if (!p2) continue;
+
+        *p1 = *p2 = 0;
+        set(p2 + 1, strtoull(p1 + 1, NULL, 10), line);
+    }
+
+    fclose(fp);
+
+    return true;
+}
+
+bool manifest::save(const std::string &path) const
+{
+    std::string tmp = path + ".tmp";
+    FILE *fp = fopen(tmp.c_str(), "we");
+    if (!fp) return false;
+
+    fprintf(fp, "%s\n", MANIFEST_MAGIC);
+
+    for (const auto &e : m_files) {
+        fprintf(fp, "%s %llu %s\n", e.second.sha1.c_str(),
+            static_cast<unsigned long long>(e.second.size), e.first.c_str());
+    }
+
+    if (fclose(fp) != 0 || rename(tmp.c_str(), path.c_str()) != 0) {
+        remove(tmp.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool manifest::parse_github_tree(const std::string &json, std::string &err)
+{
+    json_reader r(json);
+    std::string key, val;
+    bool truncated = false;
+
+    m_files.clear();
+
+    if (!r.next('{')) {
+        err = "invalid file list";
+        return false;
+    }
+
+    do {
+        if (!r.string(key) || !r.next(':')) break;
+
+        if (key == "truncated") {
+            r.scalar(val);
+            truncated = (val == "true");
+        } else if (key == "tree" && r.next('[')) {
+            if (r.next(']')) continue;
+
+            do {
+                std::string path, type, mode, sha;
+                uint64_t size = 0;
+
+                if (!r.next('{')) break;
+
+                do {
+                    if (!r.string(key) || !r.next(':')) break;
+
+                    if (key == "path") r.string(path);
+                    else if (key == "type") r.string(type);
+                    else if (key == "mode") r.string(mode);
+                    else if (key == "sha") r.string(sha);
+                    else if (key == "size" && r.scalar(val)) size = strtoull(val.c_str(), NULL, 10);
+                    else r.skip();
+                } while (r.next(','));
+
+                if (!r.next('}')) break;
+
+                /* regular files only; no symlinks or submodules, and
+                 * nothing that would be written outside of the game */
+                if (type == "blob" && mode != "120000" && path.find('\n') == std::string::npos &&
+                    manifest_safe_path(path))
+                {
+                    set(path, size, sha);
+                }
+            } while (r.next(','));
+
+            if (!r.next(']')) break;
+        } else {
+            r.skip();
+        }
+    } while (r.next(','));
+
+    if (!r.next('}')) {
+        err = "invalid file list";
+        return false;
+    }
+
+    if (truncated) {
+        err = "file list is incomplete";
+        return false;
+    }
+
+    return true;
+}
+
+void manifest::set(const std::string &path, uint64_t size, const std::string &sha1)
+{
+    manifest_entry &e = m_files[path];
+    e.size = size;
+    e.sha1 = sha1;
+}
+
+const manifest_entry *manifest::find(const std::string &path) const
+{
+    auto it = m_files.find(path);
+    return (it == m_files.end()) ? NULL : &it->second;
+}
+
+void manifest::diff(const manifest &remote,
+                    std::vector<std::string> &changed,
+                    std::vector<std::string> &removed) const
+{
+    changed.clear();
+    removed.clear();
+
+    for (const auto &e : remote.m_files) {
+        const manifest_entry *local = find(e.first);
+
+        if (!local || local->size != e.second.size || local->sha1 != e.second.sha1) {
+            changed.push_back(e.first);
+        }
+    }
+
+    for (const auto &e : m_files) {
+        if (!remote.find(e.first)) {
+            removed.push_back(e.first);
+        }
+    }
+}
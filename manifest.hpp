@@ -0,0 +1,76 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef MANIFEST_HPP
+#define MANIFEST_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+
+struct manifest_entry
+{
+    uint64_t size = 0;
+    std::string sha1;  /* git blob hash */
+};
+
+/* list of files (path, size, hash) of an installed game, relative to its
+ * data directory; hashes are git blob hashes so that they can be compared
+ * with the file list of the upstream repository */
+class manifest
+{
+private:
+
+    std::map<std::string, manifest_entry> m_files;
+
+public:
+
+    bool load(const std::string &path);
+    bool save(const std::string &path) const;
+
+    /* read the response of GitHub's "git/trees/<ref>?recursive=1" API */
+    bool parse_github_tree(const std::string &json, std::string &err);
+
+    void set(const std::string &path, uint64_t size, const std::string &sha1);
+    void erase(const std::string &path) {m_files.erase(path);}
+    const manifest_entry *find(const std::string &path) const;
+
+    const std::map<std::string, manifest_entry> &files() const {return m_files;}
+    size_t size() const {return m_files.size();}
+    bool empty() const {return m_files.empty();}
+
+    /* files that are missing or different compared to <remote>
+     * and files that don't exist in <remote> anymore */
+    void diff(const manifest &remote,
+              std::vector<std::string> &changed,
+              std::vector<std::string> &removed) const;
+};
+
+/* true if <path> is relative and stays inside of its directory:
+ * no leading '/', no empty, "." or ".." components */
+bool manifest_safe_path(const std::string &path);
+
+#endif /* MANIFEST_HPP */
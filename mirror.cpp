@@ -0,0 +1,264 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mirror.hpp"
+#include "trace.hpp"
+
+
+static std::string trim(const char *p)
+{
+    const char *end = p + strlen(p);
+
+    while (*p == ' ' || *p == '\t') p++;
+
+    while (end > p && strchr(" \t\r\n", end[-1])) end--;
+
+    return std::string(p, end - p);
+}
+
+static bool is_http_url(const std::string &s)
+{
+    return s.compare(0, 7, "http://") == 0 || s.compare(0, 8, "https://") == 0;
+}
+
+static double now()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+
+void mirror_list::add(const std::string &origin, const std::string &mirror)
+{
+    for (auto &o : m_origins) {
+        if (o.first == origin) {
+            if (std::find(o.second.begin(), o.second.end(), mirror) == o.second.end()) {
+                o.second.push_back(mirror);
+            }
+            return;
+        }
+    }
+
+    m_origins.push_back({ origin, { mirror } });
+}
+
+bool mirror_list::load(const std::string &path)
+{
+    FILE *fp = fopen(path.c_str(), "re");
+    if (!fp) return false;
+
+    char buf[4096];
+    std::string origin;
+    int line = 0;
+
+    m_error.clear();
+
+    while (fgets(buf, sizeof(buf), fp)) {
+        const std::string s = trim(buf);
+        const std::string where = "line " + std::to_string(++line) + ": ";
+
+        if (s.empty() || s[0] == '#' || s[0] == ';') {
+            continue;
+        }
+
+        if (s[0] == '[' && s.back() == ']') {
+            origin = trim(s.substr(1, s.size() - 2).c_str());
+
+            if (!is_http_url(origin)) {
+                m_error += where + "origin must be a http or https URL\n";
+                origin.clear();
+            }
+            continue;
+        }
+
+        const size_t eq = s.find('=');
+
+        if (eq == std::string::npos) {
+            m_error += where + "syntax error\n";
+            continue;
+        }
+
+        const std::string key = trim(s.substr(0, eq).c_str());
+        const std::string val = trim(s.substr(eq + 1).c_str());
+
+        if (key != "mirror") {
+            m_error += where + "unknown key: " + key + "\n";
+        } else if (origin.empty()) {
+            m_error += where + "mirror without an origin\n";
+        } else if (!is_http_url(val)) {
+            m_error += where + "mirror must be a http or https URL\n";
+        } else {
+            add(origin, val);
+        }
+    }
+
+    fclose(fp);
+
+    return true;
+}
+
+std::vector<std::string> mirror_list::sources(const std::string &url) const
+{
+    std::vector<std::string> v = { url };
+
+    for (const auto &o : m_origins) {
+        if (url.compare(0, o.first.size(), o.first) == 0) {
+            for (const auto &m : o.second) {
+                v.push_back(m + url.substr(o.first.size()));
+            }
+        }
+    }
+
+    return v;
+}
+
+
+double mirror_probe::estimate(uint64_t sample) const
+{
+    if (ttfb < 0) return 1e30;
+    if (rate <= 0) return ttfb;
+
+    return ttfb + ((size > 0) ? size : sample) / rate;
+}
+
+
+mirror_prober::mirror_prober(uint64_t sample, double seconds)
+: m_sample(sample), m_seconds(seconds)
+{
+    /* a mirror that doesn't answer in time is as good as a broken one */
+    m_client.timeout(std::max(1, static_cast<int>(seconds)));
+}
+
+void mirror_prober::add(const std::string &url)
+{
+    if (m_urls.count(url) > 0) return;
+
+    m_urls[url] = m_probes.size();
+    m_probes.push_back({});
+    m_probes.back().url = url;
+}
+
+void mirror_prober::probe(mirror_probe &p)
+{
+    TRACE_SCOPE("probe", p.url);
+    http_response res;
+    const std::vector<std::string> headers = {
+        "Range: bytes=0-" + std::to_string(m_sample - 1)
+    };
+    const double start = now();
+    double first = 0, last = 0;
+    uint64_t received = 0, first_len = 0;
+    bool enough = false;
+
+    http_block_sigpipe();
+
+    auto sink = [&] (const char *, size_t len) -> bool {
+        last = now();
+
+        if (received == 0) {
+            first = last;
+            first_len = len;
+        }
+
+        received += len;
+
+        /* stop early, the server may have ignored the range */
+        if (received >= m_sample || last - start >= m_seconds) {
+            enough = true;
+            return false;
+        }
+
+        return true;
+    };
+
+    const bool ok = m_client.get(p.url, headers, res, sink);
+
+    if (!ok && !enough) {
+        p.error = res.error.empty() ? "failed" : res.error;
+        return;
+    }
+
+    if (res.status < 200 || res.status > 299) {
+        p.error = "HTTP error " + std::to_string(res.status);
+        return;
+    }
+
+    /* "bytes 0-262143/<size>" */
+    const std::string range = res.header("content-range");
+    const size_t slash = range.rfind('/');
+
+    if (res.status == 206 && slash != std::string::npos && range[slash + 1] != '*') {
+        p.size = strtoll(range.c_str() + slash + 1, NULL, 10);
+    } else if (res.status == 200) {
+        p.size = res.content_length;
+    }
+
+    if (received == 0) {
+        /* empty file */
+        p.ttfb = now() - start;
+        return;
+    }
+
+    p.ttfb = first - start;
+
+    /* the first chunk arrived together with the headers */
+    if (last > first) {
+        p.rate = (received - first_len) / (last - first);
+    }
+}
+
+void mirror_prober::run()
+{
+    TRACE_SCOPE("probe mirrors");
+    std::vector<std::thread> threads;
+
+    for (auto &p : m_probes) {
+        threads.emplace_back(&mirror_prober::probe, this, std::ref(p));
+    }
+
+    for (auto &t : threads) {
+        t.join();
+    }
+}
+
+void mirror_prober::rank(std::vector<std::string> &urls) const
+{
+    auto estimate = [this] (const std::string &url) {
+        auto it = m_urls.find(url);
+        return (it == m_urls.end()) ? 1e30 : m_probes[it->second].estimate(m_sample);
+    };
+
+    std::stable_sort(urls.begin(), urls.end(), [&] (const std::string &a, const std::string &b) {
+        return estimate(a) < estimate(b);
+    });
+}
@@ -0,0 +1,119 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef MIRROR_HPP
+#define MIRROR_HPP
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+#include "http.hpp"
+
+class mirror_list;
+struct mirror_probe;
+class mirror_prober;
+
+
+/* Alternative servers for the files of an origin. The mirror file has one
+ * section per origin URL prefix with a "mirror=" line for every server
+ * that has the same files below another prefix:
+ *
+ *   [https://github.com/]
+ *   mirror=http://mirror.lan/github/
+ *   mirror=https://example.org/gh/
+ *
+ * Empty lines and lines starting with '#' or ';' are ignored. */
+class mirror_list
+{
+private:
+
+    std::vector<std::pair<std::string, std::vector<std::string>>> m_origins;
+    std::string m_error;
+
+public:
+
+    /* returns false if the file can't be read */
+    bool load(const std::string &path);
+
+    void add(const std::string &origin, const std::string &mirror);
+
+    /* syntax errors of the last load() */
+    const std::string &error() const {return m_error;}
+    bool empty() const {return m_origins.empty();}
+
+    /* <url> followed by the same file on every mirror of its origin */
+    std::vector<std::string> sources(const std::string &url) const;
+};
+
+/* result of fetching the beginning of a file */
+struct mirror_probe
+{
+    std::string url;
+    double ttfb = -1;       /* seconds until the first byte, -1 on error */
+    double rate = 0;        /* bytes per second after the first byte */
+    int64_t size = -1;      /* size of the whole file, if the server said so */
+    std::string error;
+
+    /* estimated seconds to download the whole file, or
+     * <sample> bytes if the size is unknown */
+    double estimate(uint64_t sample) const;
+};
+
+/* Probes many URLs at the same time with a Range request for their first
+ * bytes and ranks the sources of a file by their estimated download time.
+ * A probe is cut short after <sample> bytes or <seconds>, whatever comes
+ * first; servers that ignore the range are measured all the same. */
+class mirror_prober
+{
+private:
+
+    http_client m_client;
+    std::vector<mirror_probe> m_probes;
+    std::map<std::string, size_t> m_urls;
+    uint64_t m_sample;
+    double m_seconds;
+
+    void probe(mirror_probe &p);
+
+public:
+
+    mirror_prober(uint64_t sample = 256*1024, double seconds = 3);
+
+    /* the same URL is only probed once */
+    void add(const std::string &url);
+
+    /* blocks until all probes have finished */
+    void run();
+
+    /* sort <urls> fastest first; URLs that failed or
+     * weren't probed keep their order at the end */
+    void rank(std::vector<std::string> &urls) const;
+
+    const std::vector<mirror_probe> &probes() const {return m_probes;}
+};
+
+#endif /* MIRROR_HPP */
@@ -0,0 +1,643 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "manifest.hpp"
+#include "pack.hpp"
+#include "trace.hpp"
+#include "untar.hpp"
+
+#define PACK_MAGIC       "AOPACK1\n"
+#define PACK_TRAILER     "AOPKIDX1"
+#define PACK_FRAME_SIZE  (4*1024*1024)
+
+
+namespace
+{
+
+/* writes gzip frames to a file and keeps the index */
+class pack_writer
+{
+private:
+
+    FILE *m_fp = NULL;
+    z_stream m_zs;
+    bool m_zinit = false;
+    bool m_open = false;
+    uint64_t m_pos = 0;
+
+public:
+
+    std::vector<pack_frame> frames;
+    std::string error;
+
+    pack_writer()
+    {
+        memset(&m_zs, 0, sizeof(m_zs));
+    }
+
+    ~pack_writer()
+    {
+        if (m_zinit) deflateEnd(&m_zs);
+        if (m_fp) fclose(m_fp);
+    }
+
+    bool open(const std::string &path)
+    {
+        m_fp = fopen(path.c_str(), "wbe");
+        if (!m_fp) return fail(path + ": " + strerror(errno));
+
+        /* 16 + MAX_WBITS: write a gzip header and trailer */
+        m_zinit = (deflateInit2(&m_zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8,
+            Z_DEFAULT_STRATEGY) == Z_OK);
+
+        if (!m_zinit) return fail("cannot initialize zlib");
+
+        return output(PACK_MAGIC, 8);
+    }
+
+    bool fail(const std::string &msg)
+    {
+        if (error.empty()) error = msg;
+        return false;
+    }
+
+    bool output(const void *buf, size_t len)
+    {
+        if (fwrite(buf, 1, len, m_fp) != len) {
+            return fail(std::string("write: ") + strerror(errno));
+        }
+
+        m_pos += len;
+
+        return true;
+    }
+
+    bool deflate_data(const char *buf, size_t len, int flush)
+    {
+        unsigned char out[64*1024];
+        int rv;
+
+        m_zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(buf));
+        m_zs.avail_in = len;
+
+        do {
+            m_zs.next_out = out;
+            m_zs.avail_out = sizeof(out);
+            rv = deflate(&m_zs, flush);
+
+            if (rv == Z_STREAM_ERROR) return fail("deflate failed");
+            if (!output(out, sizeof(out) - m_zs.avail_out)) return false;
+        } while (m_zs.avail_out == 0 || (flush == Z_FINISH && rv != Z_STREAM_END));
+
+        return true;
+    }
+
+    /* append to the current frame; a new one is started if needed */
+    bool write(const char *buf, size_t len)
+    {
+        if (!m_open) {
+            frames.emplace_back();
+            frames.back().offset = m_pos;
+            m_open = true;
+        }
+
+        frames.back().unpacked += len;
+
+        return deflate_data(buf, len, Z_NO_FLUSH);
+    }
+
+    pack_frame *current() {return m_open ? &frames.back() : NULL;}
+
+    bool close_frame()
+    {
+        if (!m_open) return true;
+
+        m_open = false;
+
+        if (!deflate_data(NULL, 0, Z_FINISH)) return false;
+
+        frames.back().size = m_pos - frames.back().offset;
+        deflateReset(&m_zs);
+
+        return true;
+    }
+
+    bool finish()
+    {
+        std::string index;
+        unsigned char off[8];
+
+        if (!close_frame()) return false;
+
+        const uint64_t start = m_pos;
+
+        for (const auto &f : frames) {
+            index += "frame " + std::to_string(f.offset) + " " + std::to_string(f.size) + " " +
+                std::to_string(f.unpacked) + " " + (f.links ? "1" : "0") + "\n";
+
+            for (const auto &name : f.members) {
+                index += "member " + name + "\n";
+            }
+        }
+
+        for (int i = 0; i < 8; i++) {
+            off[i] = (start >> (8*i)) & 0xff;
+        }
+
+        if (!output(index.data(), index.size()) ||
+            !output(PACK_TRAILER, 8) ||
+            !output(off, 8))
+        {
+            return false;
+        }
+
+        int rv = fclose(m_fp);
+        m_fp = NULL;
+
+        return (rv == 0) ? true : fail(std::string("write: ") + strerror(errno));
+    }
+};
+
+/* cuts an uncompressed tar stream into groups of whole members */
+class tar_splitter
+{
+private:
+
+    pack_writer &m_out;
+
+    char m_block[512];
+    size_t m_block_len = 0;
+    uint64_t m_left = 0;
+    bool m_end = false;
+
+    /* GNU long name and pax headers of the next member */
+    std::string m_meta;
+    std::string m_longname;
+    bool m_in_meta = false;
+    char m_meta_type = 0;
+
+    /* the current member is a link */
+    bool m_link = false;
+    std::string m_links;
+    std::vector<std::string> m_link_names;
+
+    bool header();
+    bool data(const char *buf, size_t len);
+    bool member_done();
+
+public:
+
+    tar_splitter(pack_writer &out)
+    : m_out(out)
+    {}
+
+    bool write(const char *buf, size_t len);
+    bool finish();
+};
+
+bool tar_splitter::write(const char *buf, size_t len)
+{
+    while (len > 0 && !m_end) {
+        size_t n;
+
+        if (m_left == 0) {
+            n = std::min(len, sizeof(m_block) - m_block_len);
+            memcpy(m_block + m_block_len, buf, n);
+            m_block_len += n;
+
+            if (m_block_len == sizeof(m_block)) {
+                m_block_len = 0;
+                if (!header()) return false;
+            }
+        } else {
+            n = std::min<uint64_t>(len, m_left);
+            if (!data(buf, n)) return false;
+            m_left -= n;
+
+            if (m_left == 0 && !member_done()) {
+                return false;
+            }
+        }
+
+        buf += n;
+        len -= n;
+    }
+
+    return true;
+}
+
+bool tar_splitter::header()
+{
+    bool zero = true;
+
+    for (size_t i = 0; i < sizeof(m_block); i++) {
+        if (m_block[i]) {
+            zero = false;
+            break;
+        }
+    }
+
+    /* end of archive; the frames don't have an end marker */
+    if (zero) {
+        m_end = true;
+        return true;
+    }
+
+    const char type = m_block[156];
+    const int64_t size = tar_number(m_block + 124, 12);
+
+    if (size < 0) {
+        return m_out.fail("tar: invalid size");
+    }
+
+    m_left = (size + 511) & ~static_cast<uint64_t>(511);
+
+    /* keep the headers of the next member until we know where it goes */
+    if (type == 'L' || type == 'x') {
+        m_meta.append(m_block, sizeof(m_block));
+        m_in_meta = true;
+        m_meta_type = type;
+        if (type == 'L') m_longname.clear();
+        return (m_left > 0) ? true : member_done();
+    }
+
+    std::string name = m_longname;
+
+    if (name.empty()) {
+        name.assign(m_block, strnlen(m_block, 100));
+    }
+
+    m_longname.clear();
+    std::replace(name.begin(), name.end(), '\n', '?');
+
+    m_link = (type == '1' || type == '2');
+
+    if (m_link) {
+        m_links += m_meta;
+        m_links.append(m_block, sizeof(m_block));
+        m_link_names.push_back(name);
+    } else {
+        if (!m_out.write(m_meta.data(), m_meta.size()) ||
+            !m_out.write(m_block, sizeof(m_block)))
+        {
+            return false;
+        }
+        m_out.current()->members.push_back(name);
+    }
+
+    m_meta.clear();
+
+    return (m_left > 0) ? true : member_done();
+}
+
+bool tar_splitter::data(const char *buf, size_t len)
+{
+    if (m_in_meta) {
+        if (m_meta.size() + len > 2*1024*1024) {
+            return m_out.fail("tar: header too large");
+        }
+
+        m_meta.append(buf, len);
+
+        /* only used for the index */
+        if (m_meta_type == 'L') m_longname.append(buf, strnlen(buf, len));
+
+        return true;
+    }
+
+    if (m_link) {
+        m_links.append(buf, len);
+        return true;
+    }
+
+    return m_out.write(buf, len);
+}
+
+/* a frame is only closed between members */
+bool tar_splitter::member_done()
+{
+    if (m_in_meta) {
+        m_in_meta = false;
+        return true;
+    }
+
+    pack_frame *f = m_out.current();
+
+    if (f && f->unpacked >= PACK_FRAME_SIZE) {
+        return m_out.close_frame();
+    }
+
+    return true;
+}
+
+bool tar_splitter::finish()
+{
+    if (!m_end) {
+        return m_out.fail("unexpected end of archive");
+    }
+
+    if (!m_links.empty()) {
+        if (!m_out.close_frame() || !m_out.write(m_links.data(), m_links.size())) {
+            return false;
+        }
+
+        m_out.current()->links = true;
+        m_out.current()->members = m_link_names;
+    }
+
+    return m_out.finish();
+}
+
+} /* namespace */
+
+
+bool pack_archive(const std::string &src, const std::string &dst, std::string &err)
+{
+    TRACE_SCOPE("pack", dst);
+    const std::string tmp = dst + ".tmp";
+    pack_writer out;
+    tar_splitter tar(out);
+    z_stream zs;
+    unsigned char in[64*1024], buf[64*1024];
+    bool ok = true;
+    int rv = Z_OK;
+    size_t len;
+
+    FILE *fp = fopen(src.c_str(), "rbe");
+
+    if (!fp) {
+        err = src + ": " + strerror(errno);
+        return false;
+    }
+
+    memset(&zs, 0, sizeof(zs));
+
+    if (inflateInit2(&zs, 16 + MAX_WBITS) != Z_OK) {
+        fclose(fp);
+        err = "cannot initialize zlib";
+        return false;
+    }
+
+    ok = out.open(tmp);
+
+    while (ok && (len = fread(in, 1, sizeof(in), fp)) > 0) {
+        zs.next_in = in;
+        zs.avail_in = len;
+
+        while (ok && zs.avail_in > 0) {
+            zs.next_out = buf;
+            zs.avail_out = sizeof(buf);
+            rv = inflate(&zs, Z_NO_FLUSH);
+
+            if (rv != Z_OK && rv != Z_STREAM_END && rv != Z_BUF_ERROR) {
+                ok = out.fail(std::string("gzip: ") + (zs.msg ? zs.msg : "invalid data"));
+                break;
+            }
+
+            ok = tar.write(reinterpret_cast<char *>(buf), sizeof(buf) - zs.avail_out);
+
+            /* concatenated gzip members */
+            if (rv == Z_STREAM_END) {
+                inflateReset(&zs);
+            } else if (rv == Z_BUF_ERROR && zs.avail_out == sizeof(buf)) {
+                break;
+            }
+        }
+    }
+
+    inflateEnd(&zs);
+    fclose(fp);
+
+    if (ok) ok = tar.finish();
+
+    if (!ok || rename(tmp.c_str(), dst.c_str()) != 0) {
+        err = out.error.empty() ? std::string(strerror(errno)) : out.error;
+        remove(tmp.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+
+pack_extractor::pack_extractor(const std::string &path, const std::string &dir)
+: m_path(path), m_dir(dir)
+{}
+
+pack_extractor::~pack_extractor()
+{
+    if (m_fd != -1) close(m_fd);
+}
+
+void pack_extractor::fail(const std::string &msg)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_error.empty()) m_error = msg;
+}
+
+uint64_t pack_extractor::size() const
+{
+    uint64_t n = 0;
+
+    for (const auto &f : m_frames) {
+        n += f.size;
+    }
+
+    return n;
+}
+
+bool pack_extractor::open()
+{
+    struct stat st;
+    char trailer[16];
+    uint64_t start = 0;
+
+    m_fd = ::open(m_path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (m_fd == -1 || fstat(m_fd, &st) != 0) {
+        m_error = m_path + ": " + strerror(errno);
+        return false;
+    }
+
+    if (st.st_size < 24 || pread(m_fd, trailer, 16, st.st_size - 16) != 16 ||
+        memcmp(trailer, PACK_TRAILER, 8) != 0)
+    {
+        m_error = m_path + ": not a pack";
+        return false;
+    }
+
+    for (int i = 7; i >= 0; i--) {
+        start = (start << 8) | static_cast<unsigned char>(trailer[8 + i]);
+    }
+
+    const uint64_t end = st.st_size - 16;
+
+    if (start < 8 || start > end) {
+        m_error = m_path + ": invalid index";
+        return false;
+    }
+
+    std::string index(end - start, 0);
+
+    if (pread(m_fd, &index[0], index.size(), start) != static_cast<ssize_t>(index.size())) {
+        m_error = m_path + ": " + strerror(errno);
+        return false;
+    }
+
+    for (size_t pos = 0; pos < index.size(); ) {
+        size_t eol = index.find('\n', pos);
+        if (eol == std::string::npos) eol = index.size();
+
+        const std::string line = index.substr(pos, eol - pos);
+        unsigned long long offset, size, unpacked;
+        int links;
+
+        if (line.compare(0, 7, "member ") == 0 && !m_frames.empty()) {
+            m_frames.back().members.push_back(line.substr(7));
+        } else if (sscanf(line.c_str(), "frame %llu %llu %llu %d", &offset, &size, &unpacked, &links) == 4) {
+            if (offset + size > start) {
+                m_error = m_path + ": invalid index";
+                return false;
+            }
+
+            pack_frame f;
+            f.offset = offset;
+            f.size = size;
+            f.unpacked = unpacked;
+            f.links = (links != 0);
+            m_frames.push_back(f);
+        }
+
+        pos = eol + 1;
+    }
+
+    return true;
+}
+
+bool pack_extractor::extract(const pack_frame &f)
+{
+    TRACE_SCOPE("extract frame", std::to_string(f.offset));
+    tar_extractor tar(m_dir);
+    manifest m;
+    char buf[256*1024];
+
+    /* the links frame runs alone and needs to look up its targets */
+    tar.fragment(true);
+    tar.top(m_top);
+    if (m_manifest) tar.record(f.links ? m_manifest : &m);
+
+    for (uint64_t pos = 0; pos < f.size; ) {
+        const ssize_t len = pread(m_fd, buf, std::min<uint64_t>(sizeof(buf), f.size - pos), f.offset + pos);
+
+        if (len <= 0) {
+            fail(m_path + ": " + (len == 0 ? "unexpected end of file" : strerror(errno)));
+            return false;
+        }
+
+        if (!tar.write(buf, len)) {
+            fail(tar.error());
+            return false;
+        }
+
+        pos += len;
+        bytes += len;
+        if (m_progress) *m_progress += len;
+    }
+
+    if (!tar.finish()) {
+        fail(tar.error());
+        return false;
+    }
+
+    files += tar.files();
+
+    if (m_manifest && !f.links) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for (const auto &e : m.files()) {
+            m_manifest->set(e.first, e.second.size, e.second.sha1);
+        }
+    }
+
+    return true;
+}
+
+void pack_extractor::worker()
+{
+    size_t i;
+
+    while ((i = m_next++) < m_frames.size()) {
+        if (m_frames[i].links) continue;
+
+        if (!extract(m_frames[i])) {
+            /* let the other threads stop early */
+            m_next = m_frames.size();
+            return;
+        }
+    }
+}
+
+bool pack_extractor::run(int threads)
+{
+    TRACE_SCOPE("extract pack", m_path);
+    std::vector<std::thread> list;
+
+    if (m_fd == -1 && !open()) {
+        return false;
+    }
+
+    const int n = std::max(1, std::min<int>(threads, m_frames.size()));
+
+    for (int i = 0; i < n; i++) {
+        list.emplace_back(&pack_extractor::worker, this);
+    }
+
+    for (auto &t : list) {
+        t.join();
+    }
+
+    if (!m_error.empty()) {
+        return false;
+    }
+
+    /* links last, with all of their targets in place */
+    for (const auto &f : m_frames) {
+        if (f.links && !extract(f)) return false;
+    }
+
+    return true;
+}
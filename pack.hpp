@@ -0,0 +1,115 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef PACK_HPP
+#define PACK_HPP
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+class manifest;
+struct pack_frame;
+class pack_extractor;
+
+
+/* A tar.gz archive can only be inflated from start to end on a single
+ * thread. A pack holds the same tar members, cut into independently
+ * compressed gzip frames of about PACK_FRAME_SIZE bytes at member
+ * boundaries, followed by an index of the frames and their members:
+ *
+ *   "AOPACK1\n" <frame>... <index> "AOPKIDX1" <index offset, 8 bytes LE>
+ *
+ * The index is text, one "frame <offset> <size> <unpacked size> <links>"
+ * line per frame, each followed by "member <name>" lines. Hard and symbolic
+ * links may refer to members of any frame, so they're all kept in one
+ * last frame that is extracted after the others. Every frame is verified
+ * by the CRC of its gzip trailer. */
+struct pack_frame
+{
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    uint64_t unpacked = 0;
+    bool links = false;
+    std::vector<std::string> members;
+};
+
+/* transcode the tar.gz archive <src> into the pack <dst>;
+ * <dst> is only created once it's complete */
+bool pack_archive(const std::string &src, const std::string &dst, std::string &err);
+
+/* extracts the frames of a pack on a pool of threads */
+class pack_extractor
+{
+private:
+
+    std::string m_path;
+    std::string m_dir;
+    std::string m_top;
+    manifest *m_manifest = NULL;
+    std::vector<pack_frame> m_frames;
+    int m_fd = -1;
+    std::atomic<uint64_t> *m_progress = NULL;
+
+    std::mutex m_mutex;
+    std::string m_error;
+    std::atomic<size_t> m_next {0};
+
+    void worker();
+    bool extract(const pack_frame &f);
+    void fail(const std::string &msg);
+
+public:
+
+    /* progress in packed bytes; can be read from any thread */
+    std::atomic<uint64_t> bytes {0};
+    std::atomic<uint64_t> files {0};
+
+    /* extract <path> into <dir> */
+    pack_extractor(const std::string &path, const std::string &dir);
+    ~pack_extractor();
+
+    /* read the index */
+    bool open();
+
+    /* same as tar_extractor::record() */
+    void record(manifest *m) {m_manifest = m;}
+
+    /* same as tar_extractor::top() */
+    void top(const std::string &name) {m_top = name;}
+
+    /* the packed bytes are also added to <p> */
+    void progress(std::atomic<uint64_t> *p) {m_progress = p;}
+
+    bool run(int threads);
+
+    const std::vector<pack_frame> &frames() const {return m_frames;}
+    uint64_t size() const;
+
+    const std::string &error() const {return m_error;}
+};
+
+#endif /* PACK_HPP */
@@ -0,0 +1,173 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "prefetch.hpp"
+
+/* smaller files are read quickly enough on demand */
+#define PREFETCH_MIN_SIZE  (64*1024)
+
+/* read in steps so that the thread can be stopped in between */
+#define PREFETCH_CHUNK     (8*1024*1024)
+
+/* never use more than this, or a quarter of the free memory */
+#define PREFETCH_MAX_TOTAL (1024ULL*1024*1024)
+
+#define PREFETCH_MAX_DEPTH 8
+
+
+prefetcher::~prefetcher()
+{
+    m_stop = true;
+    m_cond.notify_all();
+
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+bool prefetcher::request(const std::string &dir)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_seen.insert(dir).second) {
+        return false;
+    }
+
+    /* the button under the pointer is the most likely to be clicked */
+    m_queue.push_front(dir);
+
+    if (!m_thread.joinable()) {
+        m_thread = std::thread(&prefetcher::worker, this);
+    } else {
+        m_cond.notify_one();
+    }
+
+    return true;
+}
+
+void prefetcher::worker()
+{
+    for (;;) {
+        std::string dir;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [this] {return m_stop || !m_queue.empty();});
+
+            if (m_stop) return;
+
+            dir = m_queue.front();
+            m_queue.pop_front();
+        }
+
+        run(dir);
+    }
+}
+
+void prefetcher::run(const std::string &dir)
+{
+    std::vector<file> list;
+    uint64_t budget = PREFETCH_MAX_TOTAL;
+
+    long pages = sysconf(_SC_AVPHYS_PAGES);
+    long pagesize = sysconf(_SC_PAGESIZE);
+
+    if (pages > 0 && pagesize > 0) {
+        budget = std::min<uint64_t>(budget, static_cast<uint64_t>(pages) * pagesize / 4);
+    }
+
+    scan(dir, 0, list);
+
+    /* largest first: maps, shapes, sounds */
+    std::sort(list.begin(), list.end(), [] (const file &a, const file &b) {
+        return a.size > b.size;
+    });
+
+    for (const auto &f : list) {
+        if (m_stop || !readahead(f, budget)) break;
+    }
+}
+
+void prefetcher::scan(const std::string &dir, int depth, std::vector<file> &list)
+{
+    DIR *d = opendir(dir.c_str());
+    if (!d) return;
+
+    while (struct dirent *e = readdir(d)) {
+        struct stat st;
+
+        if (e->d_name[0] == '.') continue;
+
+        std::string path = dir + "/" + e->d_name;
+
+        /* don't follow symbolic links */
+        if (lstat(path.c_str(), &st) != 0) continue;
+
+        if (S_ISDIR(st.st_mode)) {
+            if (depth < PREFETCH_MAX_DEPTH) scan(path, depth + 1, list);
+        } else if (S_ISREG(st.st_mode) && st.st_size >= PREFETCH_MIN_SIZE) {
+            list.push_back({ path, static_cast<uint64_t>(st.st_size) });
+        }
+    }
+
+    closedir(d);
+}
+
+/* returns false once the budget is used up */
+bool prefetcher::readahead(const file &f, uint64_t &budget)
+{
+    if (f.size > budget) {
+        return true;
+    }
+
+    int fd = open(f.path.c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd == -1) return true;
+
+    for (uint64_t off = 0; off < f.size && !m_stop; off += PREFETCH_CHUNK) {
+        const size_t len = std::min<uint64_t>(PREFETCH_CHUNK, f.size - off);
+
+        /* readahead() blocks until the data is in the page cache,
+         * which paces us on slow disks; fall back to the hint */
+        if (::readahead(fd, off, len) != 0) {
+            posix_fadvise(fd, off, len, POSIX_FADV_WILLNEED);
+        }
+
+        bytes += len;
+    }
+
+    close(fd);
+    budget -= f.size;
+
+    return (budget > 0);
+}
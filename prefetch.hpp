@@ -0,0 +1,79 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef PREFETCH_HPP
+#define PREFETCH_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+class prefetcher;
+
+
+/* Reads the larger files of a directory tree into the page cache on a
+ * background thread, so that a program started on it a moment later
+ * doesn't have to wait for the disk. Every directory is only read once;
+ * the most recent request is served first. */
+class prefetcher
+{
+private:
+
+    struct file
+    {
+        std::string path;
+        uint64_t size;
+    };
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<std::string> m_queue;
+    std::set<std::string> m_seen;
+    std::atomic<bool> m_stop {false};
+
+    void worker();
+    void run(const std::string &dir);
+    void scan(const std::string &dir, int depth, std::vector<file> &list);
+    bool readahead(const file &f, uint64_t &budget);
+
+public:
+
+    /* progress; can be read from any thread */
+    std::atomic<uint64_t> bytes {0};
+
+    prefetcher() {}
+    ~prefetcher();
+
+    /* returns immediately; false if <dir> was requested before */
+    bool request(const std::string &dir);
+};
+
+#endif /* PREFETCH_HPP */
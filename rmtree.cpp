@@ -0,0 +1,268 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "rmtree.hpp"
+#include "trace.hpp"
+
+/* glibc only has a wrapper since 2.30 */
+struct linux_dirent64
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+#define DIRENT_BUFSIZE (64*1024)
+#define DIR_FLAGS      (O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC)
+
+
+tree_remover::tree_remover(int threads)
+: m_threads(threads)
+{
+    if (m_threads < 1) {
+        m_threads = 1;
+    }
+}
+
+bool tree_remover::run()
+{
+    TRACE_SCOPE("delete");
+    std::vector<std::thread> threads;
+
+    for (const auto &path : m_roots) {
+        struct stat st;
+
+        if (lstat(path.c_str(), &st) != 0) {
+            if (errno != ENOENT) {
+                fail(NULL, path.c_str(), errno);
+            }
+            continue;
+        }
+
+        /* FTW_PHYS: a symbolic link is removed, not its target */
+        if (!S_ISDIR(st.st_mode)) {
+            if (unlink(path.c_str()) != 0 && errno != ENOENT) {
+                fail(NULL, path.c_str(), errno);
+            } else {
+                removed++;
+            }
+            continue;
+        }
+
+        node_ptr n = std::make_shared<node>();
+        n->name = path;
+        n->dev = st.st_dev;
+        m_queue.push_back(n);
+    }
+
+    for (int i = 0; i < m_threads && !m_queue.empty(); i++) {
+        threads.emplace_back(&tree_remover::worker, this);
+    }
+
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    return m_failed.empty();
+}
+
+void tree_remover::fail(const node_ptr &n, const char *name, int err)
+{
+    std::string path;
+
+    if (n) {
+        /* rebuild the path for the error message only */
+        for (node *p = n.get(); p; p = p->parent.get()) {
+            path.insert(0, p->name + "/");
+        }
+    }
+
+    path += name;
+    path += ": ";
+    path += strerror(err);
+
+    std::lock_guard<std::mutex> lock(m_failed_mutex);
+    m_failed.push_back(path);
+}
+
+void tree_remover::push(const node_ptr &n)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_queue.push_back(n);
+    m_cond.notify_one();
+}
+
+void tree_remover::worker()
+{
+    std::vector<char> buf(DIRENT_BUFSIZE);
+
+    for (;;) {
+        node_ptr n;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            /* done once nothing is queued and no other
+             * thread could queue anything anymore */
+            m_cond.wait(lock, [this] {return !m_queue.empty() || m_busy == 0;});
+
+            if (m_queue.empty()) {
+                m_cond.notify_all();
+                return;
+            }
+
+            /* depth first (LIFO) keeps the number of open
+             * directory fds close to the depth of the tree */
+            n = m_queue.back();
+            m_queue.pop_back();
+            m_busy++;
+        }
+
+        /* a directory that was never opened only
+         * holds a reference on its parent */
+        if (scan(n, buf)) {
+            release(n);
+        } else {
+            release(n->parent);
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_busy--;
+
+        if (m_busy == 0 && m_queue.empty()) {
+            m_cond.notify_all();
+        }
+    }
+}
+
+/* unlink everything inside of a directory and queue its subdirectories;
+ * returns false if the directory could not be opened */
+bool tree_remover::scan(const node_ptr &n, std::vector<char> &buf)
+{
+    const int dirfd = n->parent ? n->parent->fd : AT_FDCWD;
+    struct stat st;
+
+    n->fd = openat(dirfd, n->name.c_str(), DIR_FLAGS);
+
+    if (n->fd == -1) {
+        /* replaced by something that isn't a directory in the meantime */
+        if ((errno == ENOTDIR || errno == ELOOP) && n->parent) {
+            if (unlinkat(dirfd, n->name.c_str(), 0) == 0) {
+                removed++;
+            } else if (errno != ENOENT) {
+                fail(n->parent, n->name.c_str(), errno);
+            }
+        } else if (errno != ENOENT) {
+            fail(n->parent, n->name.c_str(), errno);
+        }
+        return false;
+    }
+
+    /* FTW_MOUNT: don't touch anything on a different file system;
+     * removing the parent directory will then fail with ENOTEMPTY */
+    if (fstat(n->fd, &st) != 0 || st.st_dev != n->dev) {
+        close(n->fd);
+        n->fd = -1;
+        return false;
+    }
+
+    for (;;) {
+        long len = syscall(SYS_getdents64, n->fd, buf.data(), buf.size());
+
+        if (len == 0) {
+            break;
+        } else if (len < 0) {
+            fail(n->parent, n->name.c_str(), errno);
+            break;
+        }
+
+        for (long pos = 0; pos < len; ) {
+            auto *d = reinterpret_cast<linux_dirent64 *>(buf.data() + pos);
+            const char *name = d->d_name;
+            unsigned char type = d->d_type;
+            pos += d->d_reclen;
+
+            if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0))) {
+                continue;
+            }
+
+            if (type == DT_UNKNOWN) {
+                if (fstatat(n->fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+                    if (errno != ENOENT) fail(n, name, errno);
+                    continue;
+                }
+                type = S_ISDIR(st.st_mode) ? DT_DIR : DT_REG;
+            }
+
+            if (type == DT_DIR) {
+                node_ptr child = std::make_shared<node>();
+                child->parent = n;
+                child->name = name;
+                child->dev = n->dev;
+                n->pending++;
+                push(child);
+            } else if (unlinkat(n->fd, name, 0) == 0) {
+                removed++;
+            } else if (errno != ENOENT) {
+                fail(n, name, errno);
+            }
+        }
+    }
+
+    return true;
+}
+
+/* drop one reference; the directory itself is removed as soon as
+ * its scan and all of its subdirectories are finished */
+void tree_remover::release(node_ptr n)
+{
+    while (n && --n->pending == 0) {
+        close(n->fd);
+        n->fd = -1;
+
+        const int dirfd = n->parent ? n->parent->fd : AT_FDCWD;
+
+        if (unlinkat(dirfd, n->name.c_str(), AT_REMOVEDIR) == 0) {
+            removed++;
+        } else if (errno != ENOENT) {
+            fail(n->parent, n->name.c_str(), errno);
+        }
+
+        n = n->parent;
+    }
+}
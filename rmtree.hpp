@@ -0,0 +1,96 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef RMTREE_HPP
+#define RMTREE_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/types.h>
+
+class tree_remover;
+
+
+/* Removes directory trees like "rm -rf --one-file-system" would, on a
+ * small pool of threads. Directories are read in getdents64() batches
+ * and everything is removed relative to an open directory fd, so paths
+ * are never resolved twice and symbolic links are never followed.
+ * Directories on a different file system are left alone. */
+class tree_remover
+{
+private:
+
+    struct node
+    {
+        std::shared_ptr<node> parent;
+        std::string name;   /* relative to parent->fd, or the full path of a root */
+        int fd = -1;
+        dev_t dev = 0;
+
+        /* the scan of this directory plus one for every subdirectory
+         * that is not removed yet */
+        std::atomic<int> pending {1};
+    };
+
+    typedef std::shared_ptr<node> node_ptr;
+
+    std::vector<std::string> m_roots;
+    std::vector<node_ptr> m_queue;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    size_t m_busy = 0;
+    int m_threads;
+
+    std::vector<std::string> m_failed;
+    std::mutex m_failed_mutex;
+
+    void worker();
+    bool scan(const node_ptr &n, std::vector<char> &buf);
+    void push(const node_ptr &n);
+    void release(node_ptr n);
+    void fail(const node_ptr &n, const char *name, int err);
+
+public:
+
+    /* progress; can be read from any thread */
+    std::atomic<uint64_t> removed {0};
+
+    tree_remover(int threads = 4);
+
+    void add(const std::string &path) {m_roots.push_back(path);}
+
+    /* blocks until all trees were removed; a tree that doesn't
+     * exist is not an error */
+    bool run();
+
+    /* "path: reason" of everything that could not be removed */
+    const std::vector<std::string> &failed() const {return m_failed;}
+};
+
+#endif /* RMTREE_HPP */
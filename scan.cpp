@@ -0,0 +1,350 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "scan.hpp"
+#include "trace.hpp"
+
+/* glibc only has a wrapper since 2.30 */
+struct linux_dirent64
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+#define DIRENT_BUFSIZE (32*1024)
+
+
+static int64_t mtime_ns(const struct stat &st)
+{
+    return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+
+scenario_scanner::scenario_scanner(int threads)
+: m_threads(threads)
+{
+    if (m_threads < 1) {
+        m_threads = 1;
+    }
+}
+
+scenario_scanner::~scenario_scanner()
+{
+    if (m_thread.joinable()) m_thread.join();
+    if (m_pipe[0] != -1) close(m_pipe[0]);
+    if (m_pipe[1] != -1) close(m_pipe[1]);
+}
+
+/* Cache file format, one directory per line followed by
+ * its subdirectories on lines starting with a tab:
+ *
+ *   <inode> <mtime> <0|1> <path>
+ *   \t<subdirectory>
+ */
+bool scenario_scanner::load(const std::string &path)
+{
+    FILE *fp = fopen(path.c_str(), "re");
+    if (!fp) return false;
+
+    dir_info *cur = NULL;
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t len;
+
+    m_cache.clear();
+
+    while ((len = getline(&line, &size, fp)) > 0) {
+        unsigned long long ino;
+        long long mtime;
+        int scenario, n = 0;
+
+        if (line[len - 1] == '\n') line[--len] = 0;
+
+        if (line[0] == '\t') {
+            if (cur && line[1]) cur->subdirs.push_back(line + 1);
+        } else if (sscanf(line, "%llu %lld %d %n", &ino, &mtime, &scenario, &n) == 3 && n > 0) {
+            cur = &m_cache[line + n];
+            cur->ino = ino;
+            cur->mtime = mtime;
+            cur->scenario = (scenario != 0);
+        } else {
+            cur = NULL;
+        }
+    }
+
+    free(line);
+    fclose(fp);
+
+    return true;
+}
+
+/* write to a temporary file first so the file is never half-written */
+bool scenario_scanner::save(const std::string &path)
+{
+    std::string tmp = path + ".tmp";
+    FILE *fp = fopen(tmp.c_str(), "we");
+    if (!fp) return false;
+
+    for (const auto &e : m_seen) {
+        fprintf(fp, "%llu %lld %d %s\n", static_cast<unsigned long long>(e.second.ino),
+            static_cast<long long>(e.second.mtime), e.second.scenario ? 1 : 0, e.first.c_str());
+
+        for (const auto &s : e.second.subdirs) {
+            fprintf(fp, "\t%s\n", s.c_str());
+        }
+    }
+
+    if (fclose(fp) != 0 || rename(tmp.c_str(), path.c_str()) != 0) {
+        remove(tmp.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+void scenario_scanner::add_root(const std::string &path)
+{
+    std::string s = path;
+
+    while (s.size() > 1 && s.back() == '/') {
+        s.pop_back();
+    }
+
+    m_roots.push_back(s);
+}
+
+std::vector<std::string> scenario_scanner::cached_scenarios() const
+{
+    std::vector<std::string> list;
+
+    for (const auto &e : m_cache) {
+        if (e.second.scenario && !excluded(e.first)) list.push_back(e.first);
+    }
+
+    return list;
+}
+
+bool scenario_scanner::excluded(const std::string &path) const
+{
+    for (const auto &s : m_exclude) {
+        if (path.compare(0, s.size(), s) == 0) return true;
+    }
+
+    return false;
+}
+
+void scenario_scanner::run()
+{
+    TRACE_SCOPE("scenario scan");
+    std::vector<std::thread> threads;
+
+    m_seen.clear();
+    m_found.clear();
+    dirs_read = 0;
+    dirs_cached = 0;
+
+    for (const auto &path : m_roots) {
+        if (!excluded(path)) m_queue.push_back({ path, 0 });
+    }
+
+    for (int i = 0; i < m_threads && !m_queue.empty(); i++) {
+        threads.emplace_back(&scenario_scanner::worker, this);
+    }
+
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    std::sort(m_found.begin(), m_found.end());
+}
+
+void scenario_scanner::worker()
+{
+    std::vector<char> buf(DIRENT_BUFSIZE);
+
+    for (;;) {
+        item it;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            /* done once nothing is queued and no other
+             * thread could queue anything anymore */
+            m_cond.wait(lock, [this] {return !m_queue.empty() || m_busy == 0;});
+
+            if (m_queue.empty()) {
+                m_cond.notify_all();
+                return;
+            }
+
+            it = m_queue.back();
+            m_queue.pop_back();
+            m_busy++;
+        }
+
+        visit(it, buf);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_busy--;
+
+        if (m_busy == 0 && m_queue.empty()) {
+            m_cond.notify_all();
+        }
+    }
+}
+
+/* use the cached result of a directory if its mtime didn't change,
+ * otherwise read it; then queue its subdirectories */
+void scenario_scanner::visit(const item &it, std::vector<char> &buf)
+{
+    struct stat st;
+    dir_info info;
+
+    if (stat(it.path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return;
+    }
+
+    auto c = m_cache.find(it.path);
+
+    if (c != m_cache.end() && c->second.ino == st.st_ino && c->second.mtime == mtime_ns(st)) {
+        info = c->second;
+        dirs_cached++;
+    } else {
+        info.ino = st.st_ino;
+        info.mtime = mtime_ns(st);
+        if (!read_dir(it.path, info, buf)) return;
+        dirs_read++;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (info.scenario) {
+        m_found.push_back(it.path);
+    } else if (it.depth < m_depth) {
+        for (const auto &s : info.subdirs) {
+            const std::string path = it.path + "/" + s;
+            if (!excluded(path)) m_queue.push_back({ path, it.depth + 1 });
+        }
+
+        m_cond.notify_all();
+    }
+
+    m_seen[it.path] = std::move(info);
+}
+
+bool scenario_scanner::read_dir(const std::string &path, dir_info &info, std::vector<char> &buf)
+{
+    TRACE_SCOPE("scan dir", path);
+    bool map = false, shapes = false;
+
+    const int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1) return false;
+
+    for (;;) {
+        const long len = syscall(SYS_getdents64, fd, buf.data(), buf.size());
+        if (len <= 0) break;
+
+        for (long pos = 0; pos < len; ) {
+            auto *d = reinterpret_cast<linux_dirent64 *>(buf.data() + pos);
+            const char *name = d->d_name;
+            unsigned char type = d->d_type;
+            struct stat st;
+            pos += d->d_reclen;
+
+            /* also skips "." and ".." */
+            if (name[0] == '.' || strchr(name, '\n')) {
+                continue;
+            }
+
+            if (type == DT_UNKNOWN) {
+                if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) continue;
+                type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISLNK(st.st_mode) ? DT_LNK : DT_REG;
+            }
+
+            if (type == DT_DIR) {
+                info.subdirs.push_back(name);
+            } else if (type == DT_REG || type == DT_LNK) {
+                /* i.e. "Map.sceA" and "Shapes.shpA" */
+                if (strncasecmp(name, "map", 3) == 0) map = true;
+                if (strncasecmp(name, "shapes", 6) == 0) shapes = true;
+            }
+        }
+    }
+
+    close(fd);
+
+    info.scenario = (map && shapes);
+    if (info.scenario) info.subdirs.clear();
+
+    return true;
+}
+
+bool scenario_scanner::start(const std::string &cachefile)
+{
+    if (m_thread.joinable()) {
+        finish();
+    }
+
+    if (m_pipe[0] == -1 && pipe2(m_pipe, O_NONBLOCK | O_CLOEXEC) == -1) {
+        return false;
+    }
+
+    m_cachefile = cachefile;
+
+    m_thread = std::thread([this] () {
+        run();
+        save(m_cachefile);
+        if (write(m_pipe[1], "", 1) == -1) {}
+    });
+
+    return true;
+}
+
+void scenario_scanner::finish()
+{
+    char buf[16];
+
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+
+    while (read(m_pipe[0], buf, sizeof(buf)) > 0) {}
+}
@@ -0,0 +1,128 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef SCAN_HPP
+#define SCAN_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+class scenario_scanner;
+
+
+/* Finds Aleph One scenarios (directories with a Map and a Shapes file)
+ * below a few root directories on a small pool of threads. Directories
+ * are read in getdents64() batches; hidden directories and symbolic
+ * links are skipped and the search doesn't descend into a scenario.
+ * Every directory that was read is saved with its mtime in a cache
+ * file, so on the next scan an unchanged directory is only stat()ed
+ * and its cached subdirectories are used instead of reading it again. */
+class scenario_scanner
+{
+private:
+
+    struct dir_info
+    {
+        uint64_t ino = 0;
+        int64_t mtime = 0;
+        bool scenario = false;
+        std::vector<std::string> subdirs;
+    };
+
+    struct item
+    {
+        std::string path;
+        int depth;
+    };
+
+    std::vector<std::string> m_roots;
+    std::vector<std::string> m_exclude;
+    int m_threads;
+    int m_depth = 4;
+
+    /* the cache is only read while scanning */
+    std::map<std::string, dir_info> m_cache;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::vector<item> m_queue;
+    size_t m_busy = 0;
+    std::map<std::string, dir_info> m_seen;
+    std::vector<std::string> m_found;
+
+    std::thread m_thread;
+    int m_pipe[2] = { -1, -1 };
+    std::string m_cachefile;
+
+    void worker();
+    void visit(const item &it, std::vector<char> &buf);
+    bool read_dir(const std::string &path, dir_info &info, std::vector<char> &buf);
+    bool excluded(const std::string &path) const;
+
+public:
+
+    /* statistics of the last scan; can be read from any thread */
+    std::atomic<uint64_t> dirs_read {0};
+    std::atomic<uint64_t> dirs_cached {0};
+
+    scenario_scanner(int threads = 4);
+    ~scenario_scanner();
+
+    /* roots that don't exist are ignored */
+    void add_root(const std::string &path);
+
+    /* skip every path starting with <prefix> */
+    void exclude(const std::string &prefix) {m_exclude.push_back(prefix);}
+
+    /* levels of subdirectories below a root */
+    void max_depth(int depth) {m_depth = depth;}
+
+    bool load(const std::string &path);
+    bool save(const std::string &path);
+
+    /* scenarios found by the previous scan according to the cache,
+     * without touching the disk */
+    std::vector<std::string> cached_scenarios() const;
+
+    /* blocks until all roots were scanned */
+    void run();
+
+    /* run() and save() on a background thread; call load() first */
+    bool start(const std::string &cachefile);
+
+    /* becomes readable once start() has finished */
+    int fd() const {return m_pipe[0];}
+    void finish();
+
+    /* sorted full paths of the scenarios found by run() */
+    const std::vector<std::string> &found() const {return m_found;}
+};
+
+#endif /* SCAN_HPP */
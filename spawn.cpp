@@ -0,0 +1,230 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "spawn.hpp"
+
+extern char **environ;
+
+/* SIGCHLD self-pipe, only used if pidfd_open() is not available */
+static int sigchld_pipe[2] = { -1, -1 };
+
+static void sigchld_handler(int)
+{
+    const int saved = errno;
+    if (write(sigchld_pipe[1], "", 1) == -1) {}
+    errno = saved;
+}
+
+static bool sigchld_pipe_init()
+{
+    if (sigchld_pipe[0] != -1) {
+        return true;
+    }
+
+    if (pipe2(sigchld_pipe, O_NONBLOCK | O_CLOEXEC) == -1) {
+        return false;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sigchld_handler;
+    sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigemptyset(&sa.sa_mask);
+
+    return (sigaction(SIGCHLD, &sa, NULL) == 0);
+}
+
+static int pidfd_open(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+    return syscall(SYS_pidfd_open, pid, 0);
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/* checked once; without pidfds the SIGCHLD self-pipe is used */
+static bool pidfd_supported()
+{
+    static int supported = -1;
+
+    if (supported == -1) {
+        int fd = pidfd_open(getpid());
+        supported = (fd != -1 || errno != ENOSYS);
+        if (fd != -1) close(fd);
+    }
+
+    return supported;
+}
+
+
+child_process::~child_process()
+{
+    if (m_pidfd != -1) close(m_pidfd);
+}
+
+bool child_process::start(const std::vector<std::string> &argv, bool quiet, int out,
+                          int err, bool group)
+{
+    std::vector<char *> args;
+    posix_spawn_file_actions_t fa;
+    posix_spawnattr_t attr;
+    sigset_t set;
+
+    if (running() || argv.empty()) {
+        m_error = "nothing to start";
+        return false;
+    }
+
+    /* the handler must be in place before the child can exit;
+     * it's not needed at all if the kernel has pidfds */
+    if (!pidfd_supported() && !sigchld_pipe_init()) {
+        m_error = std::string("pipe: ") + strerror(errno);
+        return false;
+    }
+
+    for (const auto &s : argv) {
+        args.push_back(const_cast<char *>(s.c_str()));
+    }
+    args.push_back(NULL);
+
+    posix_spawn_file_actions_init(&fa);
+
+    if (err != -1) {
+        posix_spawn_file_actions_addopen(&fa, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+        posix_spawn_file_actions_adddup2(&fa, (out != -1) ? out : err, STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(&fa, err, STDERR_FILENO);
+    } else if (out != -1) {
+        posix_spawn_file_actions_adddup2(&fa, out, STDOUT_FILENO);
+        posix_spawn_file_actions_addopen(&fa, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    } else if (quiet) {
+        posix_spawn_file_actions_addopen(&fa, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+        posix_spawn_file_actions_adddup2(&fa, STDOUT_FILENO, STDERR_FILENO);
+    }
+
+    /* the child shouldn't inherit our blocked signals or the
+     * SIGPIPE and SIGCHLD dispositions */
+    posix_spawnattr_init(&attr);
+    sigemptyset(&set);
+    posix_spawnattr_setsigmask(&attr, &set);
+    sigaddset(&set, SIGPIPE);
+    sigaddset(&set, SIGCHLD);
+    posix_spawnattr_setsigdefault(&attr, &set);
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF |
+        (group ? POSIX_SPAWN_SETPGROUP : 0));
+
+    const int rv = posix_spawnp(&m_pid, args[0], &fa, &attr, args.data(), environ);
+
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&fa);
+
+    if (rv != 0) {
+        m_pid = -1;
+        m_error = argv[0] + ": " + strerror(rv);
+        return false;
+    }
+
+    m_status = -1;
+    m_group = group;
+    m_pidfd = pidfd_supported() ? pidfd_open(m_pid) : -1;
+
+    /* pidfds work but we couldn't get one (out of file descriptors):
+     * use the self-pipe after all; the child may already be gone,
+     * so make sure that poll() is called once */
+    if (m_pidfd == -1 && sigchld_pipe[0] == -1) {
+        if (!sigchld_pipe_init()) {
+            m_error = std::string("pipe: ") + strerror(errno);
+        }
+
+        if (sigchld_pipe[1] != -1 && write(sigchld_pipe[1], "", 1) == -1) {}
+    }
+
+    return true;
+}
+
+bool child_process::kill(int sig)
+{
+    if (!running()) {
+        return false;
+    }
+
+    return (::kill(m_group ? -m_pid : m_pid, sig) == 0);
+}
+
+int child_process::fd() const
+{
+    return (m_pidfd != -1) ? m_pidfd : sigchld_pipe[0];
+}
+
+bool child_process::poll()
+{
+    int status;
+    char buf[64];
+
+    if (!running()) {
+        return true;
+    }
+
+    /* drain the self-pipe; the caller checks all children anyway */
+    if (m_pidfd == -1) {
+        while (read(sigchld_pipe[0], buf, sizeof(buf)) > 0) {}
+    }
+
+    pid_t rv = waitpid(m_pid, &status, WNOHANG);
+
+    if (rv == 0 || (rv == -1 && errno == EINTR)) {
+        return false;
+    }
+
+    if (rv == -1) {
+        m_status = 127;
+    } else if (WIFSIGNALED(status)) {
+        m_status = 128 + WTERMSIG(status);
+    } else {
+        m_status = WEXITSTATUS(status);
+    }
+
+    m_pid = -1;
+
+    if (m_pidfd != -1) {
+        close(m_pidfd);
+        m_pidfd = -1;
+    }
+
+    return true;
+}
@@ -0,0 +1,83 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef SPAWN_HPP
+#define SPAWN_HPP
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+class child_process;
+
+
+/* A program started with posix_spawnp() from an argument vector, without
+ * a shell in between. Its exit can be noticed without blocking through
+ * fd(), which can be watched with poll() or Fl::add_fd(). */
+class child_process
+{
+private:
+
+    pid_t m_pid = -1;
+    int m_pidfd = -1;
+    int m_status = -1;
+    bool m_group = false;
+    std::string m_error;
+
+public:
+
+    child_process() {}
+    ~child_process();
+
+    /* start argv[0], which is looked up in PATH unless it contains a
+     * slash; stdout and stderr are discarded if <quiet> is set, or
+     * stdout goes to <out> if it's not -1; if <err> is not -1, stderr
+     * (and stdout unless <out> is given) goes there and stdin is
+     * /dev/null, since nobody could answer a prompt;
+     * with <group> the child gets a process group of its own;
+     * returns false if the program could not be started */
+    bool start(const std::vector<std::string> &argv, bool quiet = false, int out = -1,
+               int err = -1, bool group = false);
+
+    /* signal the child, or its whole process group if it has one */
+    bool kill(int sig);
+
+    /* Becomes readable once the child has exited: a pidfd, or on kernels
+     * without pidfd_open() the read end of a SIGCHLD self-pipe that is
+     * shared between all children. Call poll() on every child then. */
+    int fd() const;
+
+    /* reap the child without blocking; returns true once it has exited */
+    bool poll();
+
+    bool running() const {return m_pid != -1;}
+    pid_t pid() const {return m_pid;}
+
+    /* exit code, 128+N if killed by signal N, -1 while running */
+    int status() const {return m_status;}
+
+    const std::string &error() const {return m_error;}
+};
+
+#endif /* SPAWN_HPP */
@@ -0,0 +1,193 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "trace.hpp"
+
+struct trace_event
+{
+    std::string name;
+    std::string arg;
+    char phase;
+    int64_t ts;   /* microseconds */
+    int64_t dur;
+    uint64_t id;
+    long tid;
+};
+
+static std::atomic<bool> enabled {false};
+static std::mutex mutex;
+static std::vector<trace_event> events;
+static std::string filename;
+
+static int64_t now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void add(const char *name, const std::string &arg, char phase, int64_t ts, int64_t dur, uint64_t id)
+{
+    const long tid = syscall(SYS_gettid);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    events.push_back({ name, arg, phase, ts, dur, id, tid });
+}
+
+static void escape(FILE *fp, const std::string &s)
+{
+    for (const char c : s) {
+        switch (c) {
+            case '"':  fputs("\\\"", fp); break;
+            case '\\': fputs("\\\\", fp); break;
+            case '\n': fputs("\\n", fp); break;
+            case '\t': fputs("\\t", fp); break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    fprintf(fp, "\\u%04x", c);
+                } else {
+                    fputc(c, fp);
+                }
+                break;
+        }
+    }
+}
+
+static void trace_atexit()
+{
+    trace_close();
+}
+
+
+bool trace_open(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    /* make sure the file can be written before recording anything */
+    FILE *fp = fopen(path.c_str(), "w");
+    if (!fp) return false;
+    fclose(fp);
+
+    if (filename.empty()) {
+        atexit(trace_atexit);
+    }
+
+    filename = path;
+    events.reserve(256);
+    enabled = true;
+
+    return true;
+}
+
+void trace_close()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (!enabled) return;
+    enabled = false;
+
+    FILE *fp = fopen(filename.c_str(), "w");
+    if (!fp) return;
+
+    const int pid = getpid();
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", fp);
+    fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+        "\"args\":{\"name\":\"marathon-game-launcher\"}}", pid, pid);
+
+    for (const auto &e : events) {
+        fputs(",\n{\"name\":\"", fp);
+        escape(fp, e.name);
+        fprintf(fp, "\",\"cat\":\"launcher\",\"ph\":\"%c\",\"ts\":%lld,\"pid\":%d,\"tid\":%ld",
+            e.phase, static_cast<long long>(e.ts), pid, e.tid);
+
+        if (e.phase == 'X') {
+            fprintf(fp, ",\"dur\":%lld", static_cast<long long>(e.dur));
+        } else if (e.phase == 'b' || e.phase == 'e') {
+            fprintf(fp, ",\"id\":\"0x%llx\"", static_cast<unsigned long long>(e.id));
+        } else if (e.phase == 'i') {
+            fputs(",\"s\":\"t\"", fp);
+        }
+
+        if (!e.arg.empty()) {
+            fputs(",\"args\":{\"detail\":\"", fp);
+            escape(fp, e.arg);
+            fputs("\"}", fp);
+        }
+
+        fputc('}', fp);
+    }
+
+    fputs("\n]}\n", fp);
+    fclose(fp);
+
+    events.clear();
+}
+
+bool trace_enabled()
+{
+    return enabled;
+}
+
+void trace_instant(const char *name, const std::string &arg)
+{
+    if (enabled) add(name, arg, 'i', now_us(), 0, 0);
+}
+
+void trace_async_begin(const char *name, uint64_t id, const std::string &arg)
+{
+    if (enabled) add(name, arg, 'b', now_us(), 0, id);
+}
+
+void trace_async_end(const char *name, uint64_t id)
+{
+    if (enabled) add(name, {}, 'e', now_us(), 0, id);
+}
+
+
+trace_scope::trace_scope(const char *name, const std::string &arg)
+: m_name(name)
+{
+    if (enabled) {
+        m_arg = arg;
+        m_start = now_us();
+    }
+}
+
+trace_scope::~trace_scope()
+{
+    if (m_start != -1 && enabled) {
+        add(m_name, m_arg, 'X', m_start, now_us() - m_start, 0);
+    }
+}
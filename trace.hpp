@@ -0,0 +1,71 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <string>
+#include <stdint.h>
+
+class trace_scope;
+
+
+/* Records timed phases in memory and writes them as a Chrome
+ * trace-event JSON file on exit, which can be opened in Perfetto
+ * or chrome://tracing. Does nothing unless trace_open() was called;
+ * all functions can be called from any thread. */
+
+/* start recording; the file is written by trace_close() or at exit */
+bool trace_open(const std::string &path);
+void trace_close();
+bool trace_enabled();
+
+/* a single point in time */
+void trace_instant(const char *name, const std::string &arg = {});
+
+/* a phase that doesn't end in the same scope, i.e. a child process;
+ * <id> must be unique among phases of the same name that overlap */
+void trace_async_begin(const char *name, uint64_t id, const std::string &arg = {});
+void trace_async_end(const char *name, uint64_t id);
+
+/* a phase that lasts until the end of the current scope */
+class trace_scope
+{
+private:
+
+    const char *m_name;
+    std::string m_arg;
+    int64_t m_start = -1;
+
+public:
+
+    trace_scope(const char *name, const std::string &arg = {});
+    ~trace_scope();
+};
+
+#define TRACE_CONCAT_(a, b)  a##b
+#define TRACE_CONCAT(a, b)   TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(...)     trace_scope TRACE_CONCAT(trace_scope_, __LINE__)(__VA_ARGS__)
+
+#endif /* TRACE_HPP */
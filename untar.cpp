@@ -0,0 +1,475 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <algorithm>
+#include <string>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "manifest.hpp"
+#include "untar.hpp"
+
+/* GNU long names and pax headers larger than this are rejected */
+#define TAR_MAX_META  (1024*1024)
+
+
+int64_t tar_number(const char *p, size_t len)
+{
+    int64_t n = 0;
+
+    if (static_cast<unsigned char>(p[0]) & 0x80) {
+        for (size_t i = 1; i < len; i++) {
+            n = (n << 8) | static_cast<unsigned char>(p[i]);
+        }
+        return n;
+    }
+
+    for (size_t i = 0; i < len && p[i]; i++) {
+        if (p[i] >= '0' && p[i] <= '7') {
+            n = (n << 3) | (p[i] - '0');
+        } else if (p[i] != ' ') {
+            break;
+        }
+    }
+
+    return n;
+}
+
+static std::string tar_string(const char *p, size_t len)
+{
+    return std::string(p, strnlen(p, len));
+}
+
+/* strip "./" and reject paths that would leave the target directory */
+static bool safe_path(std::string &path)
+{
+    while (path.compare(0, 2, "./") == 0) {
+        path.erase(0, 2);
+    }
+
+    while (!path.empty() && path.back() == '/') {
+        path.pop_back();
+    }
+
+    if (path.empty() || path[0] == '/') {
+        return false;
+    }
+
+    size_t pos = 0;
+
+    while (pos <= path.size()) {
+        size_t end = path.find('/', pos);
+        if (end == std::string::npos) end = path.size();
+
+        if (path.compare(pos, end - pos, "..") == 0 && end - pos == 2) {
+            return false;
+        }
+
+        pos = end + 1;
+    }
+
+    return true;
+}
+
+/* "data-marathon-master/Scripts/x.lua" -> "Scripts/x.lua" */
+static std::string strip_top(const std::string &path)
+{
+    size_t p = path.find('/');
+    return (p == std::string::npos) ? path : path.substr(p + 1);
+}
+
+
+tar_extractor::tar_extractor(const std::string &dir)
+: m_dir(dir)
+{
+    while (m_dir.size() > 1 && m_dir.back() == '/') {
+        m_dir.pop_back();
+    }
+
+    memset(&m_zs, 0, sizeof(m_zs));
+
+    /* 16 + MAX_WBITS: expect a gzip header */
+    m_zinit = (inflateInit2(&m_zs, 16 + MAX_WBITS) == Z_OK);
+}
+
+tar_extractor::~tar_extractor()
+{
+    if (m_fd != -1) close(m_fd);
+    if (m_zinit) inflateEnd(&m_zs);
+}
+
+bool tar_extractor::fail(const std::string &msg)
+{
+    if (m_error.empty()) m_error = msg;
+    return false;
+}
+
+bool tar_extractor::write(const char *buf, size_t len)
+{
+    if (!m_error.empty()) return false;
+    if (!m_zinit) return fail("cannot initialize zlib");
+
+    unsigned char out[64*1024];
+
+    m_zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(buf));
+    m_zs.avail_in = len;
+
+    while (m_zs.avail_in > 0 && m_state != TAR_END) {
+        m_zs.next_out = out;
+        m_zs.avail_out = sizeof(out);
+
+        int rv = inflate(&m_zs, Z_NO_FLUSH);
+
+        if (rv != Z_OK && rv != Z_STREAM_END && rv != Z_BUF_ERROR) {
+            return fail(std::string("gzip: ") + (m_zs.msg ? m_zs.msg : "invalid data"));
+        }
+
+        size_t n = sizeof(out) - m_zs.avail_out;
+
+        if (n > 0 && !tar_data(reinterpret_cast<char *>(out), n)) {
+            return false;
+        }
+
+        /* concatenated gzip members */
+        if (rv == Z_STREAM_END) {
+            inflateReset(&m_zs);
+        } else if (rv == Z_BUF_ERROR && n == 0) {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool tar_extractor::finish()
+{
+    if (!m_error.empty()) return false;
+
+    /* a fragment may end between any two members */
+    if (m_fragment && m_state == TAR_HEADER && m_block_len == 0 && m_longname.empty()) {
+        return true;
+    }
+
+    if (m_state != TAR_END) {
+        return fail("unexpected end of archive");
+    }
+
+    return true;
+}
+
+bool tar_extractor::tar_data(const char *buf, size_t len)
+{
+    while (len > 0 && m_state != TAR_END) {
+        size_t n;
+
+        switch (m_state) {
+            case TAR_HEADER:
+                n = std::min(len, sizeof(m_block) - m_block_len);
+                memcpy(m_block + m_block_len, buf, n);
+                m_block_len += n;
+
+                if (m_block_len == sizeof(m_block)) {
+                    m_block_len = 0;
+                    if (!header()) return false;
+                }
+                break;
+
+            case TAR_DATA:
+            case TAR_SKIP:
+            case TAR_LONGNAME:
+                n = std::min<int64_t>(len, m_left);
+
+                if (m_state == TAR_DATA) {
+                    for (size_t done = 0; done < n; ) {
+                        ssize_t rv = ::write(m_fd, buf + done, n - done);
+
+                        if (rv == -1) {
+                            if (errno == EINTR) continue;
+                            return fail(m_path + ": " + strerror(errno));
+                        }
+
+                        done += rv;
+                    }
+
+                    if (m_hash) m_hash->update(buf, n);
+                } else if (m_state == TAR_LONGNAME) {
+                    m_meta.append(buf, n);
+                }
+
+                m_left -= n;
+
+                if (m_left == 0) {
+                    if (m_state == TAR_DATA && !close_entry()) {
+                        return false;
+                    }
+
+                    if (m_state == TAR_LONGNAME) {
+                        if (m_type == 'L') {
+                            m_longname = tar_string(m_meta.data(), m_meta.size());
+                        } else {
+                            parse_pax();
+                        }
+                    }
+
+                    m_state = (m_padding > 0) ? TAR_PADDING : TAR_HEADER;
+                }
+                break;
+
+            case TAR_PADDING:
+                n = std::min(len, m_padding);
+                m_padding -= n;
+                if (m_padding == 0) m_state = TAR_HEADER;
+                break;
+
+            default:
+                return false;
+        }
+
+        buf += n;
+        len -= n;
+    }
+
+    return true;
+}
+
+/* take the "path" record from a pax extended header */
+void tar_extractor::parse_pax()
+{
+    size_t pos = 0;
+
+    /* records: "<length> <key>=<value>\n" */
+    while (pos < m_meta.size()) {
+        size_t len = strtoul(m_meta.c_str() + pos, NULL, 10);
+        if (len == 0 || pos + len > m_meta.size()) break;
+
+        std::string rec = m_meta.substr(pos, len);
+        size_t sp = rec.find(' ');
+        size_t eq = rec.find('=');
+
+        if (sp != std::string::npos && eq != std::string::npos && eq > sp) {
+            std::string key = rec.substr(sp + 1, eq - sp - 1);
+            std::string val = rec.substr(eq + 1);
+            if (!val.empty() && val.back() == '\n') val.pop_back();
+            if (key == "path") m_longname = val;
+        }
+
+        pos += len;
+    }
+}
+
+bool tar_extractor::header()
+{
+    const char *b = m_block;
+    unsigned sum = 0;
+    bool zero = true;
+
+    for (size_t i = 0; i < sizeof(m_block); i++) {
+        const unsigned char c = b[i];
+        if (c) zero = false;
+        sum += (i >= 148 && i < 156) ? ' ' : c;
+    }
+
+    /* end of archive marker */
+    if (zero) {
+        m_state = TAR_END;
+        return true;
+    }
+
+    if (sum != tar_number(b + 148, 8)) {
+        return fail("tar: invalid header checksum");
+    }
+
+    int64_t size = tar_number(b + 124, 12);
+    std::string name = m_longname;
+
+    if (name.empty()) {
+        name = tar_string(b, 100);
+
+        /* ustar prefix field */
+        if (memcmp(b + 257, "ustar", 5) == 0 && b[345]) {
+            name = tar_string(b + 345, 155) + "/" + name;
+        }
+    }
+
+    m_type = b[156];
+    m_mode = tar_number(b + 100, 8) & 0777;
+    m_mtime = tar_number(b + 136, 12);
+    m_left = m_size = size;
+    m_padding = (512 - size % 512) % 512;
+
+    switch (m_type) {
+        case 'L':
+        case 'x':
+            if (size > TAR_MAX_META) return fail("tar: header too large");
+            m_meta.clear();
+            m_state = (size > 0) ? TAR_LONGNAME : TAR_HEADER;
+            return true;
+
+        case '0': case '\0': case '7':
+        case '1': case '2': case '5':
+            break;
+
+        default:
+            /* global pax header and other entries we don't need */
+            m_state = (size > 0) ? TAR_SKIP : TAR_HEADER;
+            return true;
+    }
+
+    m_longname.clear();
+
+    if (!safe_path(name)) {
+        return fail("tar: unsafe path: " + name);
+    }
+
+    if (!m_top.empty() && name != m_top && name.compare(0, m_top.size() + 1, m_top + "/") != 0) {
+        return fail("tar: not in " + m_top + ": " + name);
+    }
+
+    std::string link = tar_string(b + 157, 100);
+
+    if (!open_entry(name, link.c_str())) {
+        return false;
+    }
+
+    if (m_fd == -1) {
+        /* links and directories don't carry data */
+        m_state = (size > 0) ? TAR_SKIP : TAR_HEADER;
+    } else if (size > 0) {
+        m_state = TAR_DATA;
+    } else {
+        m_state = TAR_HEADER;
+        return close_entry();
+    }
+
+    return true;
+}
+
+bool tar_extractor::open_entry(const std::string &name, const char *link)
+{
+    m_path = m_dir + "/" + name;
+
+    /* create parent directories; archive members are sorted
+     * so the parent is usually the same as last time */
+    std::string parent = m_path.substr(0, m_path.rfind('/'));
+
+    if (parent != m_parent) {
+        for (size_t p = m_dir.size() + 1; (p = m_path.find('/', p)) != std::string::npos; p++) {
+            std::string dir = m_path.substr(0, p);
+
+            if (mkdir(dir.c_str(), 0755) == -1 && errno != EEXIST) {
+                return fail(dir + ": " + strerror(errno));
+            }
+        }
+
+        m_parent = parent;
+    }
+
+    switch (m_type) {
+        case '5':
+            if (mkdir(m_path.c_str(), m_mode | 0700) == -1 && errno != EEXIST) {
+                return fail(m_path + ": " + strerror(errno));
+            }
+            return true;
+
+        case '2':
+            /* only allow links that stay inside the tree */
+            if (link[0] == '/' || strstr(link, "..")) {
+                return true;
+            }
+            unlink(m_path.c_str());
+            if (symlink(link, m_path.c_str()) == -1) {
+                return fail(m_path + ": " + strerror(errno));
+            }
+            return true;
+
+        case '1': {
+            std::string target = link;
+
+            if (!safe_path(target)) {
+                return fail("tar: unsafe link: " + target);
+            }
+
+            /* same content as the link target */
+            if (m_manifest) {
+                const manifest_entry *e = m_manifest->find(strip_top(target));
+                if (e) m_manifest->set(strip_top(name), e->size, e->sha1);
+            }
+
+            target = m_dir + "/" + target;
+            unlink(m_path.c_str());
+
+            if (::link(target.c_str(), m_path.c_str()) == -1) {
+                return fail(m_path + ": " + strerror(errno));
+            }
+            return true;
+        }
+
+        default:
+            break;
+    }
+
+    /* regular file; never write through an existing symlink */
+    if (m_manifest) {
+        m_hash.reset(new hasher(hasher::SHA1));
+        git_blob_header(*m_hash, m_size);
+    }
+
+    unlink(m_path.c_str());
+    m_fd = open(m_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, m_mode | 0600);
+
+    if (m_fd == -1) {
+        return fail(m_path + ": " + strerror(errno));
+    }
+
+    return true;
+}
+
+bool tar_extractor::close_entry()
+{
+    struct timespec ts[2];
+    ts[0].tv_sec = ts[1].tv_sec = m_mtime;
+    ts[0].tv_nsec = ts[1].tv_nsec = 0;
+
+    futimens(m_fd, ts);
+
+    int rv = close(m_fd);
+    m_fd = -1;
+
+    if (rv != 0) {
+        return fail(m_path + ": " + strerror(errno));
+    }
+
+    if (m_hash) {
+        m_manifest->set(strip_top(m_path.substr(m_dir.size() + 1)), m_size, m_hash->hex());
+        m_hash.reset();
+    }
+
+    m_files++;
+
+    return true;
+}
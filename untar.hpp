@@ -0,0 +1,119 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef UNTAR_HPP
+#define UNTAR_HPP
+
+#include <memory>
+#include <string>
+#include <stdint.h>
+#include <sys/types.h>
+#include <zlib.h>
+
+#include "hash.hpp"
+
+class manifest;
+
+
+/* Streaming tar.gz extractor: compressed data can be passed in
+ * chunks of any size and is written out as soon as it's inflated.
+ * Absolute paths and ".." components are rejected. */
+class tar_extractor
+{
+private:
+
+    enum {
+        TAR_HEADER,   /* waiting for a 512 byte header block */
+        TAR_DATA,     /* file data */
+        TAR_SKIP,     /* data of an entry we don't write */
+        TAR_LONGNAME, /* GNU long name or pax header data */
+        TAR_PADDING,  /* padding up to the next 512 byte block */
+        TAR_END
+    };
+
+    std::string m_dir;
+    std::string m_top;
+    std::string m_error;
+    z_stream m_zs;
+    bool m_zinit = false;
+
+    int m_state = TAR_HEADER;
+    char m_block[512];
+    size_t m_block_len = 0;
+
+    /* current entry */
+    int m_fd = -1;
+    int64_t m_left = 0;
+    size_t m_padding = 0;
+    char m_type = 0;
+    std::string m_path;
+    std::string m_meta;
+    std::string m_longname;
+    std::string m_parent;
+    mode_t m_mode = 0;
+    time_t m_mtime = 0;
+
+    bool m_fragment = false;
+    uint64_t m_files = 0;
+    manifest *m_manifest = NULL;
+    std::unique_ptr<hasher> m_hash;
+    int64_t m_size = 0;
+
+    bool fail(const std::string &msg);
+    bool tar_data(const char *buf, size_t len);
+    bool header();
+    bool open_entry(const std::string &name, const char *link);
+    bool close_entry();
+    void parse_pax();
+
+public:
+
+    tar_extractor(const std::string &dir);
+    ~tar_extractor();
+
+    /* feed compressed data */
+    bool write(const char *buf, size_t len);
+
+    /* check that the archive was complete */
+    bool finish();
+
+    /* add every extracted regular file to <m>, with paths relative
+     * to the top-level directory of the archive */
+    void record(manifest *m) {m_manifest = m;}
+
+    /* reject members outside of the top-level directory <name>
+     * before anything is written */
+    void top(const std::string &name) {m_top = name;}
+
+    /* the archive is a piece of a tar file without an end marker */
+    void fragment(bool b) {m_fragment = b;}
+
+    const std::string &error() const {return m_error;}
+    uint64_t files() const {return m_files;}
+};
+
+/* parse a numeric header field (octal or GNU base-256) */
+int64_t tar_number(const char *p, size_t len);
+
+#endif /* UNTAR_HPP */
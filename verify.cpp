@@ -0,0 +1,287 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hash.hpp"
+#include "verify.hpp"
+
+#define HASH_CACHE_MAGIC  "# marathon-game-launcher hash cache 1"
+
+
+std::string git_blob_sha1_file(const std::string &path, const struct stat &st)
+{
+    hasher h(hasher::SHA1);
+    git_blob_header(h, st.st_size);
+
+    if (st.st_size == 0) {
+        return h.hex();
+    }
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return {};
+
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    /* not mmap(): a file that is truncated while it's being
+     * hashed would kill the process with SIGBUS */
+    std::vector<char> buf(1024*1024);
+    off_t off = 0;
+
+    while (off < st.st_size) {
+        const ssize_t len = pread(fd, buf.data(), std::min<off_t>(buf.size(), st.st_size - off), off);
+
+        if (len == -1 && errno == EINTR) continue;
+
+        if (len <= 0) {
+            close(fd);
+            return {};
+        }
+
+        h.update(buf.data(), len);
+        off += len;
+    }
+
+    /* the file was changed in the meantime, the hash may be of neither version */
+    struct stat now;
+
+    if (fstat(fd, &now) != 0 || now.st_ino != st.st_ino || now.st_size != st.st_size ||
+        now.st_mtim.tv_sec != st.st_mtim.tv_sec || now.st_mtim.tv_nsec != st.st_mtim.tv_nsec)
+    {
+        close(fd);
+        return {};
+    }
+
+    close(fd);
+
+    return h.hex();
+}
+
+
+hash_cache::key hash_cache::make_key(const struct stat &st)
+{
+    key k;
+    k.dev = st.st_dev;
+    k.ino = st.st_ino;
+    k.size = st.st_size;
+    k.mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return k;
+}
+
+bool hash_cache::load(const std::string &path)
+{
+    FILE *fp = fopen(path.c_str(), "re");
+    if (!fp) return false;
+
+    char line[256];
+
+    if (!fgets(line, sizeof(line), fp) || strncmp(line, HASH_CACHE_MAGIC, strlen(HASH_CACHE_MAGIC)) != 0) {
+        fclose(fp);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    /* "<dev> <inode> <size> <mtime> <sha1>" */
+    while (fgets(line, sizeof(line), fp)) {
+        unsigned long long dev, ino, size;
+        long long mtime;
+        char sha1[64];
+
+        if (sscanf(line, "%llu %llu %llu %lld %63s", &dev, &ino, &size, &mtime, sha1) == 5) {
+            key k = { dev, ino, size, mtime };
+            m_map[k] = sha1;
+        }
+    }
+
+    fclose(fp);
+
+    return true;
+}
+
+bool hash_cache::save(const std::string &path)
+{
+    std::string tmp = path + ".tmp";
+    FILE *fp = fopen(tmp.c_str(), "we");
+    if (!fp) return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    fprintf(fp, "%s\n", HASH_CACHE_MAGIC);
+
+    for (const auto &e : m_used) {
+        fprintf(fp, "%llu %llu %llu %lld %s\n",
+            static_cast<unsigned long long>(e.first.dev),
+            static_cast<unsigned long long>(e.first.ino),
+            static_cast<unsigned long long>(e.first.size),
+            static_cast<long long>(e.first.mtime),
+            e.second.c_str());
+    }
+
+    if (fclose(fp) != 0 || rename(tmp.c_str(), path.c_str()) != 0) {
+        remove(tmp.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool hash_cache::lookup(const struct stat &st, std::string &sha1)
+{
+    const key k = make_key(st);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_map.find(k);
+
+    if (it == m_map.end()) {
+        return false;
+    }
+
+    sha1 = it->second;
+    m_used[k] = sha1;
+
+    return true;
+}
+
+void hash_cache::store(const struct stat &st, const std::string &sha1)
+{
+    const key k = make_key(st);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_map[k] = sha1;
+    m_used[k] = sha1;
+}
+
+
+verifier::verifier(hash_cache &cache, int threads)
+: m_cache(cache), m_threads(threads)
+{
+    if (m_threads < 1) {
+        m_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+void verifier::add(const std::string &dir, const manifest &m)
+{
+    m_manifests.push_back(m);
+
+    result r;
+    r.dir = dir;
+    m_results.push_back(r);
+}
+
+bool verifier::ok() const
+{
+    for (const auto &r : m_results) {
+        if (!r.missing.empty() || !r.corrupt.empty()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void verifier::prepare()
+{
+    if (m_prepared) return;
+    m_prepared = true;
+
+    /* build the task list only now that m_manifests won't move anymore */
+    for (size_t i = 0; i < m_manifests.size(); i++) {
+        for (const auto &e : m_manifests[i].files()) {
+            m_tasks.push_back({ i, m_results[i].dir + "/" + e.first, &e.second });
+        }
+    }
+
+    /* largest files first so that no thread is left with one
+     * big file at the end */
+    std::sort(m_tasks.begin(), m_tasks.end(), [] (const task &a, const task &b) {
+        return a.entry->size > b.entry->size;
+    });
+}
+
+void verifier::run()
+{
+    std::vector<std::thread> threads;
+
+    prepare();
+
+    const int n = std::min<size_t>(m_threads, m_tasks.size());
+
+    for (int i = 0; i < n; i++) {
+        threads.emplace_back(&verifier::worker, this);
+    }
+
+    for (auto &t : threads) {
+        t.join();
+    }
+}
+
+void verifier::worker()
+{
+    size_t i;
+
+    while ((i = m_next++) < m_tasks.size()) {
+        check(m_tasks[i]);
+        done++;
+    }
+}
+
+void verifier::check(const task &t)
+{
+    struct stat st;
+    std::string sha1;
+    const std::string name = t.path.substr(m_results[t.dir].dir.size() + 1);
+
+    if (stat(t.path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_results[t.dir].missing.push_back(name);
+        return;
+    }
+
+    if (static_cast<uint64_t>(st.st_size) != t.entry->size) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_results[t.dir].corrupt.push_back(name);
+        return;
+    }
+
+    if (!m_cache.lookup(st, sha1)) {
+        sha1 = git_blob_sha1_file(t.path, st);
+        if (!sha1.empty()) m_cache.store(st, sha1);
+        hashed++;
+        bytes += st.st_size;
+    }
+
+    if (sha1 != t.entry->sha1) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_results[t.dir].corrupt.push_back(name);
+    }
+}
@@ -0,0 +1,147 @@
+/*
+  Copyright (c) 2023 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef VERIFY_HPP
+#define VERIFY_HPP
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "manifest.hpp"
+
+class hash_cache;
+class verifier;
+
+
+/* remembers file hashes by (device, inode, size, mtime) so that
+ * unchanged files only need to be stat()ed the next time */
+class hash_cache
+{
+private:
+
+    struct key
+    {
+        uint64_t dev;
+        uint64_t ino;
+        uint64_t size;
+        int64_t mtime;  /* nanoseconds */
+
+        bool operator==(const key &o) const {
+            return dev == o.dev && ino == o.ino && size == o.size && mtime == o.mtime;
+        }
+    };
+
+    struct key_hash
+    {
+        size_t operator()(const key &k) const {
+            return std::hash<uint64_t>()(k.ino ^ (k.dev << 32) ^ k.size ^ k.mtime);
+        }
+    };
+
+    std::unordered_map<key, std::string, key_hash> m_map;
+    std::unordered_map<key, std::string, key_hash> m_used;
+    std::mutex m_mutex;
+
+    static key make_key(const struct stat &st);
+
+public:
+
+    bool load(const std::string &path);
+
+    /* only entries that were looked up or stored since load() are saved */
+    bool save(const std::string &path);
+
+    bool lookup(const struct stat &st, std::string &sha1);
+    void store(const struct stat &st, const std::string &sha1);
+};
+
+/* checks installed files against their manifests on all cores */
+class verifier
+{
+public:
+
+    struct result
+    {
+        std::string dir;
+        std::vector<std::string> missing;
+        std::vector<std::string> corrupt;
+    };
+
+private:
+
+    struct task
+    {
+        size_t dir;
+        std::string path;
+        const manifest_entry *entry;
+    };
+
+    hash_cache &m_cache;
+    std::vector<manifest> m_manifests;
+    std::vector<result> m_results;
+    std::vector<task> m_tasks;
+    std::atomic<size_t> m_next {0};
+    std::mutex m_mutex;
+    int m_threads;
+    bool m_prepared = false;
+
+    void worker();
+    void check(const task &t);
+
+public:
+
+    /* progress; can be read from any thread */
+    std::atomic<size_t> done {0};
+    std::atomic<size_t> hashed {0};
+    std::atomic<uint64_t> bytes {0};
+
+    verifier(hash_cache &cache, int threads = 0);
+
+    /* check all files listed in <m> inside of <dir> */
+    void add(const std::string &dir, const manifest &m);
+
+    /* build the list of files to check after the last add(); done by
+     * run() if it wasn't called before, but files() is only valid
+     * afterwards */
+    void prepare();
+
+    /* blocks until all files were checked */
+    void run();
+
+    size_t files() const {return m_tasks.size();}
+    const std::vector<result> &results() const {return m_results;}
+    bool ok() const;
+};
+
+/* git blob hash of a file with the size <st>; empty if it can't be
+ * read or if it was changed while it was being hashed */
+std::string git_blob_sha1_file(const std::string &path, const struct stat &st);
+
+#endif /* VERIFY_HPP */